@@ -1,11 +1,130 @@
 #include "wolfman_alpha/wa_machine.hpp"
 #include "wolfman_alpha/wa_io.hpp"
-#include "wolfman_alpha/wa_audio.hpp"
+#include "wolfman_alpha/wa_asset_cache.hpp"
+#include "wolfman_alpha/wa_analysis.hpp"
 #include "wolfman_alpha/wa_components.hpp"
+#include "wolfman_alpha/wa_server.hpp"
 #include <iostream>
 #include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#ifdef __linux__
+#include <csignal>
+#include <pthread.h>
+#endif
+
+namespace {
+
+wa::audio::SampleFormat parseSampleFormat(const std::string& s) {
+  if (s == "pcm16") return wa::audio::SampleFormat::Pcm16;
+  if (s == "pcm24") return wa::audio::SampleFormat::Pcm24;
+  if (s == "f32") return wa::audio::SampleFormat::Float32;
+  throw std::invalid_argument("audio format must be pcm16, pcm24 or f32");
+}
+
+// Records (`record`) or verifies the pack's fingerprints; returns the exit code.
+int runAssetQa(const std::vector<wa::audio::SoundJob>& pack, const std::string& store, bool record) {
+  auto prints = record ? std::map<std::string, wa::audio::AudioFingerprint>{} : wa::audio::load_fingerprints(store);
+  int failures = 0;
+  for (const auto& job : pack) {
+    const wa::audio::WavView wav(job.path);
+    if (!wav.isOpen()) {
+      std::cout << "FAIL " << job.path << " (unreadable)\n";
+      ++failures;
+      continue;
+    }
+    const auto fp = wa::audio::fingerprint(wav);
+    if (record) {
+      prints[job.path] = fp;
+      continue;
+    }
+    const auto it = prints.find(job.path);
+    const bool ok = it != prints.end() && wa::audio::fingerprints_match(it->second, fp);
+    std::cout << (ok ? "OK   " : "FAIL ") << job.path << "\n";
+    if (!ok) ++failures;
+  }
+  if (record) {
+    if (!wa::audio::save_fingerprints(store, prints)) return 1;
+    std::cout << "Recorded " << prints.size() << " fingerprints to " << store << "\n";
+  }
+  return failures == 0 ? 0 : 1;
+}
+
+// Serves sessions until SIGINT/SIGTERM. The signals are blocked before the
+// server threads start so only sigwait() here sees them.
+int runServer(const wa::ServerConfig& cfg) {
+#ifdef __linux__
+  sigset_t sigs;
+  sigemptyset(&sigs);
+  sigaddset(&sigs, SIGINT);
+  sigaddset(&sigs, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &sigs, nullptr);
+
+  wa::ConsoleServer server(cfg);
+  if (!server.start()) {
+    std::cerr << "cannot listen on " << cfg.socketPath << " (not a socket, in use, or not writable)\n";
+    return 1;
+  }
+  std::cerr << "serving on " << cfg.socketPath << " with " << cfg.workers << " workers\n";
+  int sig = 0;
+  sigwait(&sigs, &sig);
+  const auto commands = server.commandsExecuted();
+  server.stop();
+  std::cerr << "server stopped: " << commands << " commands\n";
+  return 0;
+#else
+  std::cerr << "--serve needs Linux (epoll + Unix domain sockets)\n";
+  (void)cfg;
+  return 1;
+#endif
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  wa::audio::WavFormat audioFormat;
+  std::string qaStore;
+  bool qaRecord = false;
+  std::string batchPath;
+  std::string replayPath;
+  wa::ServerConfig serverCfg;
+  bool serve = false;
+  wa::BatchOptions batchOpts;
+  wa::ConsoleConfig consoleCfg;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg = argv[i];
+      const bool hasValue = i + 1 < argc;
+      if (arg == "--audio-rate" && hasValue) audioFormat.sampleRate = std::stoi(argv[++i]);
+      else if (arg == "--audio-channels" && hasValue) audioFormat.channels = std::stoi(argv[++i]);
+      else if (arg == "--audio-format" && hasValue) audioFormat.format = parseSampleFormat(argv[++i]);
+      else if ((arg == "--qa-record" || arg == "--qa-check") && hasValue) {
+        qaRecord = arg == "--qa-record";
+        qaStore = argv[++i];
+      }
+      else if (arg == "--batch" && hasValue) batchPath = argv[++i];
+      else if (arg == "--replay" && hasValue) replayPath = argv[++i];
+      else if (arg == "--serve" && hasValue) {
+        serve = true;
+        serverCfg.socketPath = argv[++i];
+      }
+      else if (arg == "--workers" && hasValue) serverCfg.workers = (unsigned)std::stoul(argv[++i]);
+      else if (arg == "--quiet") batchOpts.quiet = true;
+      else if (arg == "--timestamps") batchOpts.timestamps = true;
+      else if (arg == "--json") consoleCfg.json = true;
+      else throw std::invalid_argument("unknown argument: " + arg);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n"
+              << "usage: wa_console [--audio-rate hz] [--audio-channels 1|2] [--audio-format pcm16|pcm24|f32]\n"
+              << "                  [--qa-record file | --qa-check file]\n"
+              << "                  [--replay journal] [--batch file|- [--quiet] [--timestamps]] [--json]\n"
+              << "                  [--serve socket [--workers n]]\n";
+    return 2;
+  }
 
-int main() {
   wa::Machine m(10, 360);
   wa::MechanicalComputer mech({
     64,   // wordBits
@@ -16,23 +135,50 @@ int main() {
   });
 
   std::filesystem::create_directories("assets");
+  // Startup chatter stays off stdout in JSON mode, which carries objects only.
+  std::ostream& banner = consoleCfg.json ? std::cerr : std::cout;
 
   // Original haunted clockwork sound pack (NOT film audio)
-  if (wa::audio::generate_clockwork_loop("assets/clockwork_loop.wav", 3.0, 120))
-    std::cout << "Generated assets/clockwork_loop.wav\n";
-  if (wa::audio::generate_ratchet_tick("assets/ratchet_tick.wav", 2.0, 120))
-    std::cout << "Generated assets/ratchet_tick.wav\n";
-  if (wa::audio::generate_gear_whirr("assets/gear_whirr.wav", 2.5, 140.0))
-    std::cout << "Generated assets/gear_whirr.wav\n";
-  if (wa::audio::generate_haunted_drone("assets/haunted_drone.wav", 5.0))
-    std::cout << "Generated assets/haunted_drone.wav\n";
-  if (wa::audio::generate_zodiac_13_pulse("assets/zodiac_13_pulse.wav", 6.0, 120))
-    std::cout << "Generated assets/zodiac_13_pulse.wav\n";
-
-  std::cout << m.capacityString(true) << "\n";
-  std::cout << mech.summary() << "\n";
-
-  wa::Console console(m);
+  // Only assets whose parameters, code version or file contents changed are re-rendered.
+  const auto pack = wa::audio::default_sound_pack("assets", audioFormat);
+  const auto status = wa::audio::sync_sound_pack(pack, "assets/.wa_manifest");
+  for (std::size_t i = 0; i < pack.size() && batchPath.empty(); ++i) {
+    if (status[i] == wa::audio::AssetStatus::Rendered) banner << "Generated " << pack[i].path << "\n";
+    else if (status[i] == wa::audio::AssetStatus::Cached) banner << "Cached " << pack[i].path << "\n";
+  }
+  if (!qaStore.empty()) return runAssetQa(pack, qaStore, qaRecord);
+
+  if (serve) return runServer(serverCfg);
+
+  wa::Console console(m, consoleCfg);
+  if (!replayPath.empty()) {
+    wa::ReplayStats rs;
+    const bool ok = console.replay(replayPath, rs);
+    std::cerr << "replay: " << rs.records << " records in " << rs.seconds * 1000.0 << " ms\n";
+    if (!ok) {
+      std::cerr << "replay failed: " << replayPath << " unreadable, truncated or for a different machine\n";
+      return 1;
+    }
+  }
+  if (!batchPath.empty()) {
+    std::ifstream file;
+    if (batchPath != "-") {
+      file.open(batchPath);
+      if (!file) {
+        std::cerr << "cannot open " << batchPath << "\n";
+        return 2;
+      }
+    }
+    std::ios::sync_with_stdio(false);
+    const auto stats = console.runBatch(batchPath == "-" ? std::cin : file, batchOpts);
+    std::cerr << "batch: " << stats.commands << " commands, " << stats.errors << " errors in "
+              << stats.seconds * 1000.0 << " ms (" << (std::uint64_t)stats.commandsPerSecond() << " cmd/s)\n";
+    return stats.errors == 0 ? 0 : 1;
+  }
+
+  banner << m.capacityString(true) << "\n";
+  banner << mech.summary() << "\n";
+
   console.repl();
   return 0;
 }
@@ -1,8 +1,14 @@
 #include "wolfman_alpha/wa_components.hpp"
 #include "wolfman_alpha/wa_gui.hpp"
+#include "wolfman_alpha/wa_gui_raster.hpp"
+#include "wolfman_alpha/wa_machine.hpp"
+#include "wolfman_alpha/wa_simulation.hpp"
+#include <chrono>
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <sstream>
+#include <thread>
 
 namespace {
 
@@ -37,17 +43,50 @@ void setSwitch(wa::gui::GuiWindow& w, wa::gui::WidgetId id, bool on) {
   }
 }
 
-std::string statusText(const wa::MechanicalComputer& mech) {
+// The values the status label shows; the label is only reformatted when
+// one of them changes.
+struct Status {
+  std::uint64_t ticks{0};
+  bool running{false};
+  std::size_t ip{0};
+  bool halted{false};
+  std::uint64_t r0{0};
+  std::uint64_t ram0{0};
+
+  bool operator==(const Status& o) const {
+    return ticks == o.ticks && running == o.running && ip == o.ip && halted == o.halted && r0 == o.r0 && ram0 == o.ram0;
+  }
+  bool operator!=(const Status& o) const { return !(*this == o); }
+};
+
+Status readStatus(const wa::MechanicalComputer& mech) {
+  return {mech.clock().ticks(), mech.clock().running(), mech.cpu().ip(), mech.cpu().halted(),
+          mech.registers().getU64(0), mech.ram().readU64(0)};
+}
+
+// Same values from a simulation snapshot (register 0 and RAM word 0 first).
+Status readStatus(const wa::MachineSnapshot& s) {
+  return {s.ticks, s.clockRunning, (std::size_t)s.ip, s.halted, s.regCount ? s.regs[0] : 0, s.ramCount ? s.ram[0] : 0};
+}
+
+std::string statusText(const Status& s) {
   std::ostringstream oss;
-  oss << "clk=" << mech.clock().ticks()
-      << " running=" << (mech.clock().running() ? "ON" : "OFF")
-      << " ip=" << mech.cpu().ip()
-      << " halted=" << (mech.cpu().halted() ? "YES" : "NO")
-      << " r0=" << mech.registers().getU64(0)
-      << " ram[0]=" << mech.ram().readU64(0);
+  oss << "clk=" << s.ticks
+      << " running=" << (s.running ? "ON" : "OFF")
+      << " ip=" << s.ip
+      << " halted=" << (s.halted ? "YES" : "NO")
+      << " r0=" << s.r0
+      << " ram[0]=" << s.ram0;
   return oss.str();
 }
 
+// Reformats the label only when the machine state changed.
+void refreshStatus(wa::gui::GuiWindow& w, wa::gui::WidgetId id, const Status& now, Status& shown) {
+  if (now == shown) return;
+  shown = now;
+  setLabel(w, id, statusText(now));
+}
+
 void loadDemoProgram(wa::MechanicalComputer& mech) {
   std::vector<wa::GearInstr> p;
   p.push_back({wa::GearOp::MOVI, 0, 0, 0, 1});  // R0=1
@@ -61,7 +100,23 @@ void loadDemoProgram(wa::MechanicalComputer& mech) {
 
 } // namespace
 
-int main() {
+int main(int argc, char** argv) {
+  // --ppm file: render with the software rasterizer and save the final frame.
+  // --free-run: run the machine on its own thread; the UI reads snapshots.
+  std::string ppmPath;
+  bool freeRun = false;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--ppm" && i + 1 < argc) {
+      ppmPath = argv[++i];
+    } else if (arg == "--free-run") {
+      freeRun = true;
+    } else {
+      std::cerr << "usage: wa_gui_app [--ppm frame.ppm] [--free-run]\n";
+      return 2;
+    }
+  }
+
   wa::MechanicalComputer mech({64, 8, 512, 8192, 24.0});
 
   wa::gui::GuiWindow window("WolfmanAlpha GUI Clockwork", {0, 0, 1024, 600});
@@ -72,32 +127,73 @@ int main() {
   ids.tickButton = window.addButton("Tick +1", {24, 120, 140, 32});
   ids.stepButton = window.addButton("CPU Step", {180, 120, 140, 32});
   ids.loadButton = window.addButton("Load Demo Program", {336, 120, 220, 32});
-  setLabel(window, ids.statusLabel, statusText(mech));
 
-  auto backend = std::make_unique<wa::gui::MockBackend>();
-  auto* mock = backend.get();
-  wa::gui::GuiApp app(std::move(backend), std::move(window));
+  // Gear rings turned by the clock, shown as 5x2 ring widgets.
+  wa::Machine gears(10, 360);
+  for (int r = 0; r < gears.ringCount(); ++r) {
+    for (int i = 0; i < gears.gearsPerRing(); i += r + 3) gears.setBit(r, i, 1);
+  }
+  for (int r = 0; r < gears.ringCount(); ++r) {
+    window.addRing("Ring " + std::to_string(r), {24 + (r % 5) * 196, 176 + (r / 5) * 208, 192, 204}, gears.ring(r));
+  }
+  Status shown = readStatus(mech);
+  setLabel(window, ids.statusLabel, statusText(shown));
 
-  app.onEvent([&](const wa::gui::Event& ev) {
-    switch (ev.target) {
-      case 0:
-        break;
-      default:
-        break;
-    }
+  std::unique_ptr<wa::gui::GuiBackend> backend;
+  wa::gui::MockBackend* mock = nullptr;
+  wa::gui::RasterBackend* raster = nullptr;
+  if (ppmPath.empty()) {
+    auto b = std::make_unique<wa::gui::MockBackend>();
+    mock = b.get();
+    backend = std::move(b);
+  } else {
+    auto b = std::make_unique<wa::gui::RasterBackend>();
+    raster = b.get();
+    backend = std::move(b);
+  }
+  auto queueEvent = [&](const wa::gui::Event& ev) {
+    if (mock) mock->queueEvent(ev);
+    else raster->queueEvent(ev);
+  };
+  wa::gui::GuiApp app(std::move(backend), std::move(window));
 
-    if (ev.type == wa::gui::EventType::Click && ev.target == ids.clockSwitch) {
-      if (switchState(app.window(), ids.clockSwitch)) mech.clock().start();
-      else mech.clock().stop();
-    } else if (ev.type == wa::gui::EventType::Click && ev.target == ids.tickButton) {
-      mech.clock().tick(1);
-    } else if (ev.type == wa::gui::EventType::Click && ev.target == ids.stepButton) {
-      mech.cpu().step();
-    } else if (ev.type == wa::gui::EventType::Click && ev.target == ids.loadButton) {
-      loadDemoProgram(mech);
+  // In free-run mode the simulation thread owns `mech`: clicks are posted to
+  // it, and the UI only reads the snapshots it publishes.
+  wa::SimulationThread sim(mech);
+  if (freeRun) {
+    app.subscribe([&](const wa::gui::EventQueue& batch) {
+      for (const auto& ev : batch) {
+        if (ev.type != wa::gui::EventType::Click) continue;
+        if (ev.target == ids.clockSwitch) {
+          const bool on = switchState(app.window(), ids.clockSwitch);
+          sim.post([on](wa::MechanicalComputer& m) { on ? m.clock().start() : m.clock().stop(); });
+        } else if (ev.target == ids.autoTickSwitch) {
+          sim.setFreeRun(switchState(app.window(), ids.autoTickSwitch));
+        } else if (ev.target == ids.tickButton) {
+          sim.post([](wa::MechanicalComputer& m) { m.clock().tick(1); });
+        } else if (ev.target == ids.stepButton) {
+          sim.post([](wa::MechanicalComputer& m) { m.cpu().step(); });
+        } else if (ev.target == ids.loadButton) {
+          sim.post(loadDemoProgram);
+        }
+      }
+    });
+  } else app.subscribe([&](const wa::gui::EventQueue& batch) {
+    for (const auto& ev : batch) {
+      if (ev.type != wa::gui::EventType::Click) continue;
+      if (ev.target == ids.clockSwitch) {
+        if (switchState(app.window(), ids.clockSwitch)) mech.clock().start();
+        else mech.clock().stop();
+      } else if (ev.target == ids.tickButton) {
+        mech.clock().tick(1);
+        gears.tickAll(1);
+      } else if (ev.target == ids.stepButton) {
+        mech.cpu().step();
+      } else if (ev.target == ids.loadButton) {
+        loadDemoProgram(mech);
+      }
     }
-
-    setLabel(app.window(), ids.statusLabel, statusText(mech));
+    refreshStatus(app.window(), ids.statusLabel, readStatus(mech), shown);
   });
 
   if (!app.start()) {
@@ -106,20 +202,55 @@ int main() {
   }
 
   // Demo script for the mock backend: load program, step CPU, toggle auto tick, pulse ticks.
-  mock->queueEvent({wa::gui::EventType::Click, ids.loadButton});
-  mock->queueEvent({wa::gui::EventType::Click, ids.stepButton});
-  mock->queueEvent({wa::gui::EventType::Click, ids.autoTickSwitch});
-  mock->queueEvent({wa::gui::EventType::Click, ids.tickButton});
-  mock->queueEvent({wa::gui::EventType::Click, ids.stepButton});
-
-  for (int i = 0; i < 5; ++i) {
-    if (switchState(app.window(), ids.autoTickSwitch)) mech.clock().tick(1);
-    app.runFrame();
-    setLabel(app.window(), ids.statusLabel, statusText(mech));
+  queueEvent({wa::gui::EventType::Click, ids.loadButton});
+  queueEvent({wa::gui::EventType::Click, ids.stepButton});
+  queueEvent({wa::gui::EventType::Click, ids.autoTickSwitch});
+  queueEvent({wa::gui::EventType::Click, ids.tickButton});
+  queueEvent({wa::gui::EventType::Click, ids.stepButton});
+
+  if (freeRun) {
+    // ~60 Hz for half a second while the machine runs flat out; the rings
+    // turn by however many ticks passed since the previous frame.
+    sim.start();
+    std::uint64_t ringTicks = sim.snapshot().ticks;
+    auto next = std::chrono::steady_clock::now();
+    for (int i = 0; i < 30; ++i) {
+      const wa::MachineSnapshot& snap = sim.snapshot();
+      gears.tickAll((int)((snap.ticks - ringTicks) % (std::uint64_t)gears.gearsPerRing()));
+      ringTicks = snap.ticks;
+      app.window().refreshRings();
+      refreshStatus(app.window(), ids.statusLabel, readStatus(snap), shown);
+      app.runFrame();
+      next += std::chrono::microseconds(16667);
+      std::this_thread::sleep_until(next);
+    }
+    sim.stop();
+  } else {
+    for (int i = 0; i < 5; ++i) {
+      if (switchState(app.window(), ids.autoTickSwitch)) {
+        mech.clock().tick(1);
+        gears.tickAll(1);
+      }
+      app.window().refreshRings();
+      refreshStatus(app.window(), ids.statusLabel, readStatus(mech), shown);
+      app.runFrame();
+    }
   }
+  // Idle frames: nothing changes, so nothing is redrawn.
+  for (int i = 0; i < 5; ++i) app.runFrame();
 
   std::cout << "WolfmanAlpha GUI app initialized\n";
-  std::cout << statusText(mech) << "\n";
+  std::cout << statusText(readStatus(mech)) << "\n";
+  if (freeRun) std::cout << "simulation: " << sim.snapshot().steps << " CPU steps in 30 UI frames\n";
+  std::cout << "frames drawn=" << app.framesDrawn() << " skipped=" << app.framesSkipped() << "\n";
+  if (raster) {
+    const double ms = raster->frames() ? raster->totalFrameSeconds() * 1e3 / (double)raster->frames() : 0.0;
+    std::cout << "raster: " << raster->pixelsPainted() << " pixels painted, " << ms << " ms/frame\n";
+    if (!raster->framebuffer().writePpm(ppmPath)) {
+      std::cerr << "cannot write " << ppmPath << "\n";
+      return 1;
+    }
+  }
   if (!switchState(app.window(), ids.clockSwitch)) setSwitch(app.window(), ids.clockSwitch, true);
 
   app.stop();
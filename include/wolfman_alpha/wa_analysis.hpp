@@ -0,0 +1,76 @@
+#pragma once
+#include "wa_wav_view.hpp"
+#include <complex>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace wa::audio {
+
+// Radix-2 FFT plan; twiddles and the bit-reversal table are built once.
+class Fft {
+public:
+  explicit Fft(int size); // size must be a power of two >= 2
+
+  int size() const { return n_; }
+
+  // In-place forward transform of size() complex values.
+  void forward(std::complex<double>* x) const;
+
+  // Hann-windowed magnitude spectrum of size() real samples; writes
+  // size()/2 + 1 bins scaled so a full-scale sine peaks near 1.0.
+  void magnitudes(const double* in, double* out) const;
+
+private:
+  int n_{0};
+  std::vector<std::complex<double>> twiddle_;
+  std::vector<int> bitrev_;
+  std::vector<double> window_;
+  double windowGain_{1.0};
+};
+
+struct LevelWindow {
+  std::uint64_t frame{0}; // first frame of the window
+  double rms{0.0};
+  double peak{0.0};
+};
+
+// Magnitude spectrum of `size` frames starting at `frame0` (channels averaged).
+std::vector<double> spectrum(const WavView& wav, std::uint64_t frame0, int size);
+
+// RMS and absolute peak over consecutive windows of `windowFrames`.
+std::vector<LevelWindow> window_levels(const WavView& wav, int windowFrames);
+
+// Click onsets: frames where short-time energy (hops of `hopFrames`) jumps
+// by more than `ratio` over the mean of the preceding hops and exceeds
+// `floorRms`. Onsets closer than 4 hops to the previous one are merged.
+std::vector<std::uint64_t> detect_onsets(const WavView& wav, int hopFrames = 256, double ratio = 4.0, double floorRms = 1e-3);
+
+// Compact perceptual summary used for asset QA. Each window of
+// kFingerprintWindow frames contributes its RMS and kFingerprintBands
+// log-spaced band energies, all in whole decibels clamped to [-120, 20].
+inline constexpr int kFingerprintWindow = 4096;
+inline constexpr int kFingerprintBands = 8;
+
+struct AudioFingerprint {
+  int sampleRate{0};
+  int channels{0};
+  std::uint64_t frames{0};
+  std::uint32_t onsets{0};
+  std::vector<std::int8_t> db; // per window: rms then bands
+
+  std::string toString() const;
+  static bool parse(const std::string& s, AudioFingerprint& out);
+};
+
+AudioFingerprint fingerprint(const WavView& wav);
+
+// True when shape and onset count agree and every dB cell is within `tolDb`.
+bool fingerprints_match(const AudioFingerprint& a, const AudioFingerprint& b, int tolDb = 1);
+
+// Fingerprint store: one "<path> <fingerprint>" line per asset.
+std::map<std::string, AudioFingerprint> load_fingerprints(const std::string& path);
+bool save_fingerprints(const std::string& path, const std::map<std::string, AudioFingerprint>& prints);
+
+} // namespace wa::audio
@@ -0,0 +1,28 @@
+#pragma once
+#include "wa_audio.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace wa::audio {
+
+// Bump whenever any generator's output changes so cached assets rebuild.
+inline constexpr int kSoundCodeVersion = 1;
+
+enum class AssetStatus { Cached, Rendered, Failed };
+
+// FNV-1a 64-bit, used for both manifest keys and file checksums.
+std::uint64_t fnv1a64(const void* data, std::size_t size, std::uint64_t seed = 0xcbf29ce484222325ull);
+
+// Hash of everything that determines a job's output: kind, parameters,
+// output format, file name and kSoundCodeVersion.
+std::uint64_t sound_job_key(const SoundJob& job);
+
+// Brings the files named by `jobs` up to date against the manifest at
+// `manifestPath`. A job is skipped when the manifest has an entry for its
+// path with a matching key and the file on disk still matches the stored
+// size and checksum; everything else is rendered via render_sound_pack and
+// the manifest is rewritten.
+std::vector<AssetStatus> sync_sound_pack(const std::vector<SoundJob>& jobs, const std::string& manifestPath, unsigned threads = 0);
+
+} // namespace wa::audio
@@ -1,8 +1,70 @@
 #pragma once
+#include "wa_synth.hpp"
+#include <cstdint>
+#include <fstream>
 #include <string>
+#include <vector>
 
 namespace wa::audio {
 
+enum class SampleFormat { Pcm16, Pcm24, Float32 };
+
+struct WavFormat {
+  int sampleRate{44100};
+  int channels{1}; // 1 or 2
+  SampleFormat format{SampleFormat::Pcm16};
+
+  int bytesPerSample() const { return format == SampleFormat::Pcm16 ? 2 : (format == SampleFormat::Pcm24 ? 3 : 4); }
+};
+
+// Writes interleaved [-1, 1] frames (channels values per frame). PCM formats
+// clamp; Float32 stores samples as-is.
+bool write_wav(const std::string& path, const WavFormat& fmt, const std::vector<double>& interleaved);
+
+enum class SoundKind { ClockworkLoop, RatchetTick, GearWhirr, HauntedDrone, Zodiac13Pulse };
+
+struct SoundJob {
+  SoundKind kind{SoundKind::ClockworkLoop};
+  std::string path;
+  double seconds{1.0};
+  double rate{120.0}; // bpm for loop/tick/pulse, base hz for whirr, unused for drone
+  WavFormat format{};
+};
+
+// The five pack assets at their startup lengths, written under `dir`.
+std::vector<SoundJob> default_sound_pack(const std::string& dir, const WavFormat& format = {});
+
+// Graph definition behind a pack job, built at the job's sample rate.
+SynthGraph sound_graph(const SoundJob& job);
+
+// Renders any graph for `seconds` at fmt.sampleRate. Mono graphs are copied
+// to both channels of a stereo file; stereo graphs are averaged for mono.
+bool render_graph(const SynthGraph& graph, const std::string& path, double seconds, const WavFormat& fmt = {});
+
+bool render_sound(const SoundJob& job);
+
+// Renders all jobs on a pool of `threads` workers (0 = hardware concurrency).
+// Each job is split into chunks of `chunkSamples` (rounded to whole blocks);
+// output is bit-identical to render_sound. Returns per-job write success.
+std::vector<bool> render_sound_pack(const std::vector<SoundJob>& jobs, unsigned threads = 0, int chunkSamples = 32768);
+
+// Incremental WAV writer; the header sizes are patched on close().
+class WavStreamWriter {
+public:
+  ~WavStreamWriter() { close(); }
+
+  bool open(const std::string& path, const WavFormat& fmt);
+  bool writeFrames(const double* interleaved, std::size_t frames);
+  bool close();
+  bool isOpen() const { return f_.is_open(); }
+  std::uint64_t frames() const { return frames_; }
+
+private:
+  std::ofstream f_;
+  WavFormat fmt_{};
+  std::uint64_t frames_{0};
+};
+
 bool generate_clockwork_loop(const std::string& path, double seconds=3.0, int bpm=120);
 bool generate_ratchet_tick(const std::string& path, double seconds=1.0, int bpm=120);
 bool generate_gear_whirr(const std::string& path, double seconds=2.0, double hz=140.0);
@@ -1,5 +1,6 @@
 #pragma once
 #include "wa_types.hpp"
+#include "wa_sound_event.hpp"
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -135,6 +136,11 @@ public:
   std::size_t ip() const { return ip_; }
   void step();
 
+  // Emits one Instr event per executed instruction (and Halt) stamped with
+  // the mechanical clock tick; pass nullptr to detach.
+  void attachSoundEvents(SoundEventQueue* q) { sound_ = SoundEventSink(q); }
+  const SoundEventSink& soundEvents() const { return sound_; }
+
 private:
   GearRegisterBank& regs_;
   GearRAM& ram_;
@@ -144,6 +150,7 @@ private:
   std::vector<GearInstr> program_;
   std::size_t ip_{0};
   bool halted_{false};
+  SoundEventSink sound_;
 };
 
 class MechanicalComputer {
@@ -2,6 +2,8 @@
 #include "wa_machine.hpp"
 #include "wa_alu.hpp"
 #include "wa_zodiac.hpp"
+#include "wa_sound_event.hpp"
+#include <memory>
 #include <vector>
 #include <string>
 
@@ -29,10 +31,25 @@ public:
 
   void loadProgram(std::vector<Instr> p) { prog_ = std::move(p); ip_ = 0; halted_ = false; }
   bool halted() const { return halted_; }
+  u64 cycles() const { return cycles_; }
+  std::size_t ip() const { return ip_; }
+  // Puts the execution state back as saved by a journal header.
+  void restoreState(std::size_t ip, bool halted, u64 cycles) { ip_ = ip; halted_ = halted; cycles_ = cycles; }
+
+  // Routes instruction/shift/zodiac/halt events to `q` when cfg.soundEvents
+  // is set; pass nullptr to detach. The queue must outlive the CPU. Events
+  // are stamped with Machine::ticks(), not cycles(), so stamps keep rising
+  // across CPU rebuilds.
+  void attachSoundEvents(SoundEventQueue* q) { sound_ = SoundEventSink(cfg_.soundEvents ? q : nullptr); }
+  const SoundEventSink& soundEvents() const { return sound_; }
 
   void step();
   std::string regDump(int countBits=64) const;
 
+  int regCount() const { return (int)R_.size(); }
+  int wordBits() const { return word_bits(cfg_.wordSize); }
+  u8 regBit(int reg, int bit) const { return get_word_bit(m_, R_.at((std::size_t)reg), bit); }
+
 protected:
   Machine& m_;
   CpuConfig cfg_;
@@ -40,6 +57,8 @@ protected:
   std::vector<Instr> prog_;
   std::size_t ip_{0};
   bool halted_{false};
+  u64 cycles_{0};
+  SoundEventSink sound_;
 
   void exec(const Instr& ins);
 };
@@ -48,4 +67,7 @@ class CPU64  : public CpuBase { public: explicit CPU64(Machine& m); };
 class CPU360 : public CpuBase { public: explicit CPU360(Machine& m); };
 class CPU720 : public CpuBase { public: explicit CPU720(Machine& m); };
 
+// CPU profile for a word size of 64, 360 or 720 bits.
+std::unique_ptr<CpuBase> make_cpu(int wordBits, Machine& m);
+
 } // namespace wa
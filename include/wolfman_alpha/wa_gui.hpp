@@ -1,13 +1,17 @@
 #pragma once
+#include "wa_ring.hpp"
+#include "wa_zodiac.hpp"
+#include <array>
 #include <cstdint>
 #include <functional>
 #include <memory>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 namespace wa::gui {
 
+// Generational handle: slot index in the low 32 bits, slot generation in the
+// high 32. Generations start at 1, so 0 is never a valid id ("no target").
 using WidgetId = std::uint64_t;
 
 struct Vec2i {
@@ -47,33 +51,141 @@ struct Event {
   std::string text;
 };
 
+// Reusable event buffer. Elements are overwritten in place on reuse, so a
+// steady event rate allocates nothing (Event::text keeps its capacity).
+//
+// MouseMove and ValueChanged are coalesced: within a burst (the events since
+// the last event of any other type) only the latest one per (type, target)
+// is kept, in the slot of the first. Clicks, keys and text are never merged
+// or reordered, so a burst of thousands of moves costs one event.
+class EventQueue {
+public:
+  void push(const Event& ev);
+  void clear() {
+    size_ = 0;
+    burstStart_ = 0;
+  }
+
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  Event* begin() { return buf_.data(); }
+  Event* end() { return buf_.data() + size_; }
+  const Event* begin() const { return buf_.data(); }
+  const Event* end() const { return buf_.data() + size_; }
+  const Event& operator[](std::size_t i) const { return buf_[i]; }
+
+  std::uint64_t coalesced() const { return coalesced_; } // events merged away, ever
+
+private:
+  std::vector<Event> buf_;
+  std::size_t size_{0};
+  std::size_t burstStart_{0};
+  std::uint64_t coalesced_{0};
+};
+
+// Uniform grid over the window area for coordinate hit tests. Each widget is
+// listed in every cell its bounds overlap, so a lookup scans one cell.
+class WidgetGrid {
+public:
+  static constexpr int kCellSize = 64;
+
+  void reset(Rect area);
+  void insert(WidgetId id, std::uint64_t z, Rect r);
+  void erase(WidgetId id, Rect r);
+  // Topmost (highest z) widget containing the point, or 0.
+  WidgetId hit(int x, int y) const;
+  // Appends every widget overlapping r, each once, in no particular order.
+  void query(Rect r, std::vector<WidgetId>& out) const;
+
+private:
+  struct Entry {
+    WidgetId id;
+    std::uint64_t z;
+    Rect r;
+  };
+
+  Rect area_;
+  int cols_{0};
+  int rows_{0};
+  std::vector<std::vector<Entry>> cells_;
+
+  bool cellSpan(Rect r, int& c0, int& r0, int& c1, int& r1) const;
+};
+
+// Screen areas that changed since the last drawn frame. Rects are clipped to
+// the window; once more than kMaxRects accumulate they collapse into their
+// bounding box, so a burst of changes costs a bounded amount per frame.
+class DamageList {
+public:
+  static constexpr std::size_t kMaxRects = 16;
+
+  void setClip(Rect clip) { clip_ = clip; }
+  void add(Rect r);
+  void addAll() { add(clip_); }
+  void clear() { rects_.clear(); }
+  bool empty() const { return rects_.empty(); }
+  const std::vector<Rect>& rects() const { return rects_; }
+
+private:
+  Rect clip_;
+  std::vector<Rect> rects_;
+};
+
+// Window-side state that widgets update directly. Heap-held by GuiWindow so
+// widgets' pointers to it survive moving the window.
+struct WidgetHost {
+  WidgetGrid grid;
+  DamageList damage;
+  std::vector<WidgetId> dirty; // widgets changed since the last drawn frame
+  std::vector<WidgetId> queryIds; // scratch for GuiWindow::widgetsIn()
+};
+
 enum class WidgetKind {
   Label,
   Button,
   Input,
   Switch,
-  Panel
+  Panel,
+  Ring
 };
 
 class Widget {
 public:
   Widget(WidgetId id, WidgetKind kind, std::string text, Rect bounds);
   virtual ~Widget() = default;
+  Widget(const Widget&) = default;
+  Widget(Widget&&) = default;
+  Widget& operator=(const Widget&) = default;
+  Widget& operator=(Widget&&) = default;
 
   WidgetId id() const { return id_; }
   WidgetKind kind() const { return kind_; }
   const std::string& text() const { return text_; }
-  void setText(std::string value) { text_ = std::move(value); }
+  void setText(std::string value); // no-op (and no redraw) if unchanged
   const Rect& bounds() const { return bounds_; }
-  void setBounds(Rect r) { bounds_ = r; }
+  void setBounds(Rect r);   // keeps the window's hit-test grid current
   bool visible() const { return visible_; }
-  void setVisible(bool v) { visible_ = v; }
+  void setVisible(bool v);  // hidden widgets are dropped from the grid
   bool enabled() const { return enabled_; }
-  void setEnabled(bool e) { enabled_ = e; }
+  void setEnabled(bool e);
+
+  // Bumped on every visible change; dirty until the window's next drawn frame.
+  std::uint64_t z() const { return z_; } // stacking order; higher is on top
+  std::uint64_t version() const { return version_; }
+  bool dirty() const { return dirty_; }
 
   virtual bool handleEvent(const Event& ev);
 
+protected:
+  void touch(); // record a visible change: damage bounds, mark dirty
+
 private:
+  friend class GuiWindow;
+
+  WidgetHost* host_{nullptr}; // owning window's state; null when detached
+  std::uint64_t z_{0};        // creation order; later widgets are on top
+  std::uint64_t version_{0};
+  bool dirty_{false};
   WidgetId id_{0};
   WidgetKind kind_{WidgetKind::Label};
   std::string text_;
@@ -99,35 +211,130 @@ public:
   SwitchWidget(WidgetId id, std::string text, Rect bounds, bool initialOn = false);
   bool handleEvent(const Event& ev) override;
   bool on() const { return on_; }
-  void setOn(bool value) { on_ = value; }
+  void setOn(bool value);
 
 private:
   bool on_{false};
 };
 
+// Per-gear pixel offsets from the ring centre for one (gearCount, radius),
+// from math::polar at math::ring_index_to_angle_rad. Built once and shared,
+// so drawing a ring does no trig.
+struct RingLut {
+  int gearCount{0};
+  int radius{0};
+  std::vector<std::int16_t> dx;
+  std::vector<std::int16_t> dy;
+  std::array<int, ZODIAC_COUNT> glyphFirst{}; // first gear index of each glyph
+
+  // Cached; the reference stays valid for the life of the program.
+  static const RingLut& get(int gearCount, int radius);
+};
+
+// Draws a Ring's gear bits around a circle, with the read position (offset)
+// and the active zodiac glyph's sector highlighted. The widget keeps a copy
+// of what it last showed; refresh() compares the ring against it and marks
+// the widget dirty only when something changed.
+class RingWidget final : public Widget {
+public:
+  RingWidget(WidgetId id, std::string text, Rect bounds, const Ring* ring);
+
+  const Ring* ring() const { return ring_; }
+  bool refresh(); // true if the ring changed since the last refresh
+
+  // State as of the last refresh(), in physical gear order.
+  const std::vector<u8>& bits() const { return bits_; }
+  int offset() const { return offset_; }
+  Zodiac13 glyph() const { return activeGlyphFromOffset(offset_, (int)bits_.size()); }
+  int radius() const;
+
+private:
+  const Ring* ring_;
+  std::vector<u8> bits_;
+  int offset_{0};
+};
+
 class GuiWindow {
 public:
   GuiWindow(std::string title, Rect bounds);
 
   const std::string& title() const { return title_; }
-  void setTitle(std::string title) { title_ = std::move(title); }
+  void setTitle(std::string title);
   const Rect& bounds() const { return bounds_; }
-  void setBounds(Rect r) { bounds_ = r; }
+  void setBounds(Rect r); // re-grids every widget
 
   WidgetId addLabel(const std::string& text, Rect bounds);
   WidgetId addButton(const std::string& text, Rect bounds);
   WidgetId addInput(const std::string& text, Rect bounds);
   WidgetId addSwitch(const std::string& text, Rect bounds, bool initialOn = false);
+  // `ring` must outlive the widget.
+  WidgetId addRing(const std::string& text, Rect bounds, const Ring& ring);
+  // Invalidates the id; a later widget may reuse the slot with a new generation.
+  bool remove(WidgetId id);
+
+  // Pointers stay valid until the next add or remove.
   Widget* find(WidgetId id);
   const Widget* find(WidgetId id) const;
+  std::size_t widgetCount() const { return slots_.size() - freeSlots_.size(); }
   std::vector<WidgetId> widgetIds() const;
+
+  // Topmost visible widget under (x, y), or 0.
+  WidgetId hitTest(int x, int y) const { return host_->grid.hit(x, y); }
+  // Visible widgets overlapping r (clipped to the window), bottom to top.
+  // Costs the grid cells r covers, not the widget count.
+  void widgetsIn(Rect r, std::vector<const Widget*>& out) const;
+  // Fills in ev.target from the mouse position for untargeted mouse events.
+  void resolveTarget(Event& ev) const;
   bool dispatch(const Event& ev);
 
+  // Retained-mode redraw state. Backends repaint damageRects() (or just
+  // dirtyWidgets()); GuiApp skips drawing when nothing is damaged and calls
+  // frameDrawn() after a draw.
+  bool needsRedraw() const { return !host_->damage.empty(); }
+  const std::vector<Rect>& damageRects() const { return host_->damage.rects(); }
+  const std::vector<WidgetId>& dirtyWidgets() const { return host_->dirty; }
+  void invalidate() { host_->damage.addAll(); }
+  void frameDrawn();
+
+  // Visits every widget kind by kind, each kind's widgets stored contiguously.
+  template <class Fn>
+  void forEachWidget(Fn&& fn) const {
+    for (const auto& w : labels_) fn(w);
+    for (const auto& w : buttons_) fn(w);
+    for (const auto& w : inputs_) fn(w);
+    for (const auto& w : switches_) fn(w);
+    for (const auto& w : rings_) fn(w);
+  }
+
+  // Re-reads every RingWidget's ring; returns how many changed.
+  int refreshRings();
+
 private:
-  WidgetId nextId_{1};
+  struct Slot {
+    std::uint32_t generation{1};
+    std::uint32_t index{0}; // position in the kind's dense array
+    WidgetKind kind{WidgetKind::Label};
+    bool live{false};
+  };
+
   std::string title_;
   Rect bounds_;
-  std::unordered_map<WidgetId, std::unique_ptr<Widget>> widgets_;
+  std::vector<Slot> slots_;
+  std::vector<std::uint32_t> freeSlots_;
+  std::vector<Widget> labels_;
+  std::vector<ButtonWidget> buttons_;
+  std::vector<InputWidget> inputs_;
+  std::vector<SwitchWidget> switches_;
+  std::vector<RingWidget> rings_;
+  std::unique_ptr<WidgetHost> host_;
+  std::uint64_t nextZ_{1};
+
+  template <class T, class... Args>
+  WidgetId add(std::vector<T>& dense, WidgetKind kind, Args&&... args);
+  template <class T>
+  void eraseDense(std::vector<T>& dense, std::uint32_t index);
+  const Slot* slotOf(WidgetId id) const;
+  Widget* widgetAt(const Slot& slot);
 };
 
 class GuiBackend {
@@ -136,7 +343,8 @@ public:
 
   virtual bool init() = 0;
   virtual void shutdown() = 0;
-  virtual std::vector<Event> pollEvents() = 0;
+  // Appends pending input to `out` (which the caller reuses across frames).
+  virtual void pollEvents(EventQueue& out) = 0;
   virtual void draw(const GuiWindow& window) = 0;
 };
 
@@ -144,7 +352,7 @@ class MockBackend final : public GuiBackend {
 public:
   bool init() override;
   void shutdown() override;
-  std::vector<Event> pollEvents() override;
+  void pollEvents(EventQueue& out) override;
   void draw(const GuiWindow& window) override;
 
   void queueEvent(const Event& ev);
@@ -152,30 +360,40 @@ public:
 
 private:
   bool ready_{false};
-  std::vector<Event> pending_;
+  EventQueue pending_;
   std::vector<std::string> frameLog_;
 };
 
 class GuiApp {
 public:
   using EventHook = std::function<void(const Event&)>;
+  // Receives all of a frame's events at once, after widgets handled them.
+  using BatchHook = std::function<void(const EventQueue&)>;
 
   GuiApp(std::unique_ptr<GuiBackend> backend, GuiWindow window);
 
   bool start();
   void stop();
-  void runFrame();
-  void onEvent(EventHook hook) { hook_ = std::move(hook); }
+  void runFrame(); // skips the draw when the window has no damage
+  // Per-event convenience wrapper over subscribe().
+  void onEvent(EventHook hook);
+  void subscribe(BatchHook hook) { hooks_.push_back(std::move(hook)); }
+  std::uint64_t eventsCoalesced() const { return events_.coalesced(); }
 
   GuiWindow& window() { return window_; }
   const GuiWindow& window() const { return window_; }
   bool running() const { return running_; }
+  std::uint64_t framesDrawn() const { return framesDrawn_; }
+  std::uint64_t framesSkipped() const { return framesSkipped_; }
 
 private:
   std::unique_ptr<GuiBackend> backend_;
   GuiWindow window_;
   bool running_{false};
-  EventHook hook_{};
+  std::uint64_t framesDrawn_{0};
+  std::uint64_t framesSkipped_{0};
+  EventQueue events_;
+  std::vector<BatchHook> hooks_;
 };
 
 } // namespace wa::gui
@@ -0,0 +1,83 @@
+#pragma once
+#include "wa_gui.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace wa::gui {
+
+// 0xAABBGGRR: R,G,B,A bytes in memory order on little-endian hosts.
+using Rgba = std::uint32_t;
+
+constexpr Rgba rgba(std::uint8_t r, std::uint8_t g, std::uint8_t b, std::uint8_t a = 255) {
+  return (Rgba)r | ((Rgba)g << 8) | ((Rgba)b << 16) | ((Rgba)a << 24);
+}
+
+// In-memory RGBA framebuffer. Fills and blits work a row at a time on
+// contiguous 32-bit pixels (std::fill_n / memcpy), which compilers lower to
+// vector stores; every operation clips to the buffer.
+class Framebuffer {
+public:
+  void resize(int width, int height);
+  int width() const { return width_; }
+  int height() const { return height_; }
+  const std::vector<Rgba>& pixels() const { return pixels_; }
+  Rgba at(int x, int y) const { return pixels_[(std::size_t)y * width_ + x]; }
+
+  void fill(Rect r, Rgba color);
+  void frame(Rect r, Rgba color); // 1 px outline
+  // Copies src's srcRect to (dx, dy).
+  void blit(const Framebuffer& src, Rect srcRect, int dx, int dy);
+  void setPixel(int x, int y, Rgba color) {
+    if (x >= 0 && y >= 0 && x < width_ && y < height_) pixels_[(std::size_t)y * width_ + x] = color;
+  }
+
+  // Binary PPM (P6); alpha is dropped. Returns false on I/O failure.
+  bool writePpm(const std::string& path) const;
+
+private:
+  int width_{0};
+  int height_{0};
+  std::vector<Rgba> pixels_;
+
+  bool clip(Rect& r) const;
+};
+
+// Headless GuiBackend that rasterizes the window into a Framebuffer.
+// Only the window's damage rectangles are repainted, so idle or small
+// changes cost little; a resize repaints everything. Text is drawn as
+// greeked 5x7 cells (no font rasterizer).
+class RasterBackend final : public GuiBackend {
+public:
+  bool init() override;
+  void shutdown() override;
+  void pollEvents(EventQueue& out) override;
+  void draw(const GuiWindow& window) override;
+
+  void queueEvent(const Event& ev);
+  const Framebuffer& framebuffer() const { return fb_; }
+  // Writes the framebuffer after the next draw.
+  void dumpNextFrame(std::string path) { dumpPath_ = std::move(path); }
+
+  std::uint64_t frames() const { return frames_; }
+  std::uint64_t pixelsPainted() const { return pixelsPainted_; }
+  double lastFrameSeconds() const { return lastFrameSeconds_; }
+  double totalFrameSeconds() const { return totalFrameSeconds_; }
+
+private:
+  bool ready_{false};
+  EventQueue pending_;
+  Framebuffer fb_;
+  std::vector<const Widget*> visible_; // reused per damage rect
+  std::string dumpPath_;
+  std::uint64_t frames_{0};
+  std::uint64_t pixelsPainted_{0};
+  double lastFrameSeconds_{0.0};
+  double totalFrameSeconds_{0.0};
+
+  void paintRect(const GuiWindow& window, Rect damage);
+  void paintWidget(const Widget& w, Rect clip, int originX, int originY);
+  void paintRing(const RingWidget& w, Rect wb, Rect clip);
+};
+
+} // namespace wa::gui
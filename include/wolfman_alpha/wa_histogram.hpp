@@ -0,0 +1,74 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+namespace wa {
+
+// Fixed-size log-linear histogram (HDR style) for latencies in nanoseconds.
+//
+// Values below 32 get exact buckets; above that each power of two is split
+// into 16 buckets, so any recorded value is reported within 1/16 (~6%).
+// Values of 2^37 ns (~137 s) and up share the top bucket. record() is a few
+// integer ops and one increment: no allocation, no floating point.
+class LatencyHistogram {
+public:
+  static constexpr int kSubBits = 4;
+  static constexpr int kSub = 1 << kSubBits; // buckets per power of two
+  static constexpr int kMaxShift = 32;
+  static constexpr int kBuckets = 2 * kSub + kMaxShift * kSub;
+
+  void record(std::uint64_t ns) {
+    counts_[bucketOf(ns)]++;
+    count_++;
+    sum_ += ns;
+    if (ns > max_) max_ = ns;
+  }
+
+  void reset() { *this = LatencyHistogram{}; }
+
+  std::uint64_t count() const { return count_; }
+  std::uint64_t sum() const { return sum_; }
+  std::uint64_t max() const { return max_; }
+
+  // Smallest bucket upper bound covering fraction q of the samples, capped
+  // at the recorded maximum. q in [0, 1]; 0 for an empty histogram.
+  std::uint64_t percentile(double q) const {
+    if (count_ == 0) return 0;
+    std::uint64_t rank = (std::uint64_t)(q * (double)count_ + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > count_) rank = count_;
+    std::uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+      seen += counts_[i];
+      if (seen >= rank) {
+        const std::uint64_t hi = upperBound(i);
+        return hi < max_ ? hi : max_;
+      }
+    }
+    return max_;
+  }
+
+private:
+  std::array<std::uint64_t, kBuckets> counts_{};
+  std::uint64_t count_{0};
+  std::uint64_t sum_{0};
+  std::uint64_t max_{0};
+
+  static int bucketOf(std::uint64_t v) {
+    if (v < 2 * kSub) return (int)v;
+    int e = kSubBits + 1; // v >= 2*kSub; latencies are short, so count up
+    while (e < 63 && (v >> (e + 1)) != 0) ++e;
+    const int shift = e - kSubBits; // v >> shift in [kSub, 2*kSub)
+    if (shift > kMaxShift) return kBuckets - 1;
+    return 2 * kSub + (shift - 1) * kSub + (int)((v >> shift) - kSub);
+  }
+
+  static std::uint64_t upperBound(int idx) {
+    if (idx < 2 * kSub) return (std::uint64_t)idx;
+    const int shift = (idx - 2 * kSub) / kSub + 1;
+    const std::uint64_t sub = (std::uint64_t)((idx - 2 * kSub) % kSub + kSub);
+    return ((sub + 1) << shift) - 1;
+  }
+};
+
+} // namespace wa
@@ -2,41 +2,102 @@
 #include "wa_machine.hpp"
 #include "wa_cpu.hpp"
 #include "wa_zodiac.hpp"
+#include "wa_sonify.hpp"
+#include "wa_output.hpp"
+#include "wa_journal.hpp"
+#include "wa_json.hpp"
+#include "wa_calc.hpp"
+#include "wa_histogram.hpp"
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
-#include <deque>
 #include <cstdint>
 #include <chrono>
+#include <ctime>
+#include <istream>
+#include <array>
 
 namespace wa {
 
 struct ConsoleConfig {
   int printCount{64};
+  // Write output to std::cout from a background thread. When off, output
+  // accumulates until the owner collects it with takeOutput() (used by
+  // server sessions, which drive the console through executeLine()).
+  bool stdoutWriter{true};
+  // Start in JSON-lines mode (see `format json`).
+  bool json{false};
+  // Allow commands that open files by path (`journal on`, `sonify on`,
+  // `replay`). Off for server sessions, whose clients are remote.
+  bool fileCommands{true};
 };
 
+struct BatchOptions {
+  bool quiet{false};      // suppress command output (errors still go to stderr)
+  bool timestamps{false}; // stamp output lines like the interactive console
+};
+
+struct BatchStats {
+  std::uint64_t commands{0};
+  std::uint64_t errors{0};
+  double seconds{0.0};
+
+  double commandsPerSecond() const { return seconds > 0.0 ? (double)commands / seconds : 0.0; }
+};
+
+// Input/Output/Event panes. Each pane is a fixed-capacity ring of lines
+// whose bytes live in one arena allocated up front, so pushing a line never
+// allocates and memory stays at maxLines * lineBytes per pane. When a pane
+// is full (by line count or bytes) its oldest lines are dropped; a single
+// line longer than the pane's byte budget keeps only its leading bytes.
 class WindowApi {
 public:
-  explicit WindowApi(std::size_t maxLines = 128) : maxLines_(maxLines) {}
+  explicit WindowApi(std::size_t maxLines = 128, std::size_t lineBytes = 160);
+
+  void pushInput(std::string_view line);
+  void pushOutput(std::string_view line);
+  void pushEvent(std::string_view line);
 
-  void pushInput(const std::string& line);
-  void pushOutput(const std::string& line);
-  void pushEvent(const std::string& line);
+  std::size_t inputLines() const { return panes_[kInput].count; }
+  std::size_t outputLines() const { return panes_[kOutput].count; }
+  std::size_t eventLines() const { return panes_[kEvents].count; }
 
   std::string inputPrompt() const;
-  std::string renderInput() const;
-  std::string renderOutput() const;
-  std::string renderEvents() const;
+
+  // Append the rendered pane(s) to `sink`.
+  void renderInput(std::string& sink) const;
+  void renderOutput(std::string& sink) const;
+  void renderEvents(std::string& sink) const;
+  void renderAll(std::string& sink) const;
+
   std::string renderAll() const;
 
 private:
+  enum { kInput, kOutput, kEvents, kPaneCount };
+
+  struct Slot {
+    std::size_t offset{0}; // into the pane's arena region
+    std::size_t length{0};
+  };
+
+  struct Pane {
+    std::size_t base{0};   // start of this pane's region in arena_
+    std::size_t bytes{0};  // region size
+    std::size_t head{0};   // oldest slot
+    std::size_t count{0};
+    std::size_t write{0};  // next write offset within the region
+    std::size_t used{0};   // bytes held by live lines; lines may wrap the region end
+    std::vector<Slot> slots;
+  };
+
   std::size_t maxLines_;
-  std::deque<std::string> input_;
-  std::deque<std::string> output_;
-  std::deque<std::string> events_;
+  std::vector<char> arena_;
+  Pane panes_[kPaneCount];
 
-  void pushLine(std::deque<std::string>& pane, const std::string& line);
-  std::string renderPane(const char* title, const std::deque<std::string>& pane) const;
+  void pushLine(Pane& pane, std::string_view line);
+  void dropOldest(Pane& pane);
+  void renderPane(const char* title, const Pane& pane, std::string& sink) const;
 };
 
 class IoClock {
@@ -45,32 +106,92 @@ public:
 
   void onCommand();
   void onGearTick(int k);
+  void addGearTicks(std::uint64_t k);
 
   std::uint64_t commandCount() const { return commandCount_; }
   std::uint64_t gearTicks() const { return gearTicks_; }
 
+  // Per-command-kind latency; `kind` is the caller's command id.
+  static constexpr int kMaxCommandKinds = 32;
+  void recordLatency(int kind, std::uint64_t ns) { latency_[kind].record(ns); }
+  const LatencyHistogram& latency(int kind) const { return latency_[kind]; }
+  void resetLatency();
+
   std::string promptTag() const;
-  std::string stamp(const char* channel, const std::string& msg) const;
+  std::string stamp(const char* channel, std::string_view msg) const;
+  // Same as stamp() but reuses `out`'s storage.
+  void stampInto(std::string& out, const char* channel, std::string_view msg) const;
 
 private:
   std::chrono::system_clock::time_point startedAt_;
   std::uint64_t commandCount_{0};
   std::uint64_t gearTicks_{0};
+  std::array<LatencyHistogram, kMaxCommandKinds> latency_;
 
-  static std::string timeNowString();
+  // "HH:MM:SS" for cachedSecond_; reformatted only when the second changes.
+  mutable std::time_t cachedSecond_{-1};
+  mutable char cachedTime_[9]{};
+
+  const char* timeNow() const;
 };
 
 class Console {
 public:
   explicit Console(Machine& m, ConsoleConfig cfg = {});
+  ~Console();
+
   void repl();
 
+  // Executes every line of `in` without prompts. Output is buffered and
+  // written in large chunks; errors are reported on stderr with their line
+  // number. Stops at `quit` or end of input.
+  BatchStats runBatch(std::istream& in, const BatchOptions& opts = {});
+
+  // Re-applies a binary journal to this console's machine and CPU.
+  bool replay(const std::string& path, ReplayStats& stats);
+
+  // Building blocks for front ends other than repl()/runBatch().
+  void greet();
+  std::string prompt() const;
+  bool executeLine(const std::string& line); // false once the line was `quit`
+  void takeOutput(std::string& out);         // appends and clears pending output
+
 private:
+  enum class LineResult { Ok, Error, Quit };
+  enum class CommandId : u8;
+
+  // One parsed statement of a `;` chain or `repeat` block.
+  struct ScriptNode {
+    CommandId cmd;
+    std::string op;                  // lower-cased command name
+    std::vector<std::string> tokens;
+    int repeat{0};                   // CommandId::Repeat: iteration count
+    bool verbose{false};             // ... and whether the body's output is kept
+    std::vector<ScriptNode> body;
+  };
+
+  static constexpr std::size_t kOutFlushBytes = 64 * 1024;
   Machine& m_;
   ConsoleConfig cfg_;
   std::unique_ptr<CpuBase> cpu_;
   WindowApi windows_;
   IoClock clock_;
+  std::unique_ptr<SoundEventQueue> soundQueue_;
+  std::unique_ptr<audio::EventSonifier> sonifier_;
+  JournalWriter journal_;
+  std::unique_ptr<OutputWriter> writer_; // null when cfg_.stdoutWriter is off
+  std::string outBuf_;
+  std::string stampBuf_;
+  std::string lastError_;
+  bool json_{false};
+  JsonLine jsonLine_;
+  std::string jsonMsgs_;   // escaped "out" strings of the current command
+  bool quiet_{false};
+  bool stampOutput_{true};
+  bool muted_{false};      // inside a non-verbose repeat: no stamps, panes or output
+  // True while the current command's JSON object is being built; false when
+  // muted, so repeated bodies skip field building as well as the envelope.
+  bool jsonFields() const { return json_ && !muted_; }
 
   static std::vector<std::string> split(const std::string& s);
   static Dir parseDir(const std::string& s);
@@ -78,13 +199,33 @@ private:
   void emitOutput(const std::string& msg);
   void emitEvent(const std::string& msg);
   void recordInput(const std::string& line);
-
-  void help() const;
+  void writeOut(std::string_view text);
+  void emitText(std::string_view text);
+  void printRing(int r, int count, DumpFormat fmt);
+  void emitLinearSolution(const calc::LinearEquationResult& res);
+  void flushOutput(); // hand the buffer to the writer thread (if any)
+  void syncOutput();  // ... and wait until it reached the terminal
+
+  static CommandId parseCommandId(const std::string& op);
+  static const char* commandName(CommandId cmd);
+  LineResult execute(const std::string& line);
+  LineResult executeScript(const std::string& line);
+  LineResult runNodes(const std::vector<ScriptNode>& nodes);
+  LineResult runRepeat(const ScriptNode& node);
+  LineResult runCommand(CommandId cmd, const std::string& op, const std::vector<std::string>& t); // adds the JSON envelope
+  LineResult dispatch(CommandId cmd, const std::vector<std::string>& t);
+  void beginJson(const std::string& op, std::uint64_t n);
+  void endJson(LineResult r);
+  void help();
 
   static Zodiac13 parseGlyph(const std::string& s);
   static std::string glyphName(Zodiac13 g);
 
-  void dialRingToGlyph(int ring, Zodiac13 target);
+  int dialRingToGlyph(int ring, Zodiac13 target); // returns steps taken
+  void sonify(const std::vector<std::string>& t);
+  void journal(const std::vector<std::string>& t);
+  void requireFileCommands(const char* what) const;
+  void clockStats();
 };
 
 } // namespace wa
@@ -0,0 +1,77 @@
+#pragma once
+#include "wa_machine.hpp"
+#include "wa_cpu.hpp"
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace wa {
+
+// Compact binary log of state-changing console commands.
+//
+// File layout: "WAJ2", varint ringCount and gearsPerRing, then a snapshot of
+// the state the records apply to: CPU word bits, ip, halted and cycles, and
+// per ring its offset, dir and gear bits (logical order, packed LSB first).
+// Replay restores the snapshot first, so it reproduces the recorded session
+// whatever state the target machine is in. Records follow. Each record is one opcode byte followed by its operands as LEB128 varints
+// (signed operands zigzag-encoded). Records store effects, not text: a dial
+// stores the ring's resulting offset and direction, so replay never has to
+// search for the glyph again.
+enum class JournalOp : u8 {
+  Set = 1,   // ring, index, value
+  Flip = 2,  // ring, index
+  Shift = 3, // ring, dir, steps
+  Tick = 4,  // steps
+  Run = 5,   // steps
+  Mode = 6,  // word bits
+  Dial = 7,  // ring, dir + 1 (0 = ring did not move), offset
+};
+
+class JournalWriter {
+public:
+  ~JournalWriter() { close(); }
+
+  bool open(const std::string& path, const Machine& m, const CpuBase& cpu);
+  bool close();
+  bool isOpen() const { return f_.is_open(); }
+  std::uint64_t records() const { return records_; }
+
+  void set(int ring, int index, int value);
+  void flip(int ring, int index);
+  void shift(int ring, Dir d, int steps);
+  void tick(int steps);
+  void run(int steps);
+  void mode(int wordBits);
+  // `moved` is false when the ring was already on the target glyph.
+  void dial(int ring, bool moved, Dir d, int offset);
+
+private:
+  static constexpr std::size_t kFlushBytes = 64 * 1024;
+
+  std::ofstream f_;
+  std::vector<u8> buf_;
+  std::uint64_t records_{0};
+
+  void op(JournalOp o);
+  void uvar(std::uint64_t v);
+  void svar(std::int64_t v);
+  void flushBuffer();
+};
+
+struct ReplayStats {
+  std::uint64_t records{0};
+  std::uint64_t gearTicks{0}; // sum of Tick records
+  double seconds{0.0};
+};
+
+// Restores the journal's starting snapshot into `m` and `cpu` (replaced with
+// the recorded word size), then re-applies its records. Returns false if the
+// file cannot be read, was recorded against a different machine geometry, or
+// is truncated/corrupt; a bad snapshot leaves the machine untouched, records
+// before a later fault stay applied.
+// Machine range errors propagate as exceptions, as they would from the console.
+bool replay_journal(const std::string& path, Machine& m, std::unique_ptr<CpuBase>& cpu, ReplayStats& stats);
+
+} // namespace wa
@@ -0,0 +1,172 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+namespace wa {
+
+// Builds one JSON object into a reusable buffer: no streams, and no
+// allocation once the buffer has grown to the largest line seen.
+// Keys are trusted literals; string values are escaped.
+class JsonLine {
+public:
+  void begin() {
+    buf_.clear();
+    buf_ += '{';
+    first_ = true;
+  }
+
+  // Closes the object and appends a newline; returns the finished line.
+  std::string_view end() {
+    buf_ += "}\n";
+    return buf_;
+  }
+
+  JsonLine& field(const char* key, std::string_view v) {
+    keyPrefix(key);
+    string(v);
+    return *this;
+  }
+  JsonLine& field(const char* key, const char* v) { return field(key, std::string_view(v)); }
+  JsonLine& field(const char* key, bool v) {
+    keyPrefix(key);
+    buf_ += v ? "true" : "false";
+    return *this;
+  }
+  JsonLine& field(const char* key, std::int64_t v) {
+    keyPrefix(key);
+    if (v < 0) {
+      buf_ += '-';
+      unsignedValue(0 - (std::uint64_t)v);
+    } else {
+      unsignedValue((std::uint64_t)v);
+    }
+    return *this;
+  }
+  JsonLine& field(const char* key, int v) { return field(key, (std::int64_t)v); }
+  JsonLine& field(const char* key, std::uint64_t v) {
+    keyPrefix(key);
+    unsignedValue(v);
+    return *this;
+  }
+  JsonLine& field(const char* key, double v) {
+    keyPrefix(key);
+    number(v);
+    return *this;
+  }
+
+  // Raw access for arrays: `beginArray(key)`, then `element*()`, `endArray()`.
+  JsonLine& beginArray(const char* key) {
+    keyPrefix(key);
+    buf_ += '[';
+    firstElem_ = true;
+    return *this;
+  }
+  JsonLine& element(std::string_view v) {
+    elemPrefix();
+    string(v);
+    return *this;
+  }
+  JsonLine& element(double v) {
+    elemPrefix();
+    number(v);
+    return *this;
+  }
+  // Starts an element and returns the buffer so the caller can write the
+  // value (for example a quoted hex string) directly.
+  std::string& elementRaw() {
+    elemPrefix();
+    return buf_;
+  }
+  JsonLine& endArray() {
+    buf_ += ']';
+    return *this;
+  }
+
+  // Same as elementRaw() for an object field.
+  std::string& raw(const char* key) {
+    keyPrefix(key);
+    return buf_;
+  }
+
+  const std::string& str() const { return buf_; }
+
+  // Appends `v` to `out` as a quoted, escaped JSON string.
+  static void appendString(std::string& out, std::string_view v) {
+    static const char* kHex = "0123456789abcdef";
+    out += '"';
+    for (char c : v) {
+      const auto u = (unsigned char)c;
+      if (c == '"' || c == '\\') {
+        out += '\\';
+        out += c;
+      } else if (c == '\n') {
+        out += "\\n";
+      } else if (u < 0x20) {
+        out += "\\u00";
+        out += kHex[u >> 4];
+        out += kHex[u & 15];
+      } else {
+        out += c;
+      }
+    }
+    out += '"';
+  }
+
+private:
+  std::string buf_;
+  bool first_{true};
+  bool firstElem_{true};
+
+  void keyPrefix(const char* key) {
+    if (!first_) buf_ += ',';
+    first_ = false;
+    buf_ += '"';
+    buf_ += key;
+    buf_ += "\":";
+  }
+
+  void elemPrefix() {
+    if (!firstElem_) buf_ += ',';
+    firstElem_ = false;
+  }
+
+  void unsignedValue(std::uint64_t v) {
+    char tmp[20];
+    char* p = tmp + sizeof(tmp);
+    do {
+      *--p = (char)('0' + v % 10);
+      v /= 10;
+    } while (v != 0);
+    buf_.append(p, (std::size_t)(tmp + sizeof(tmp) - p));
+  }
+
+  void number(double v) {
+    if (!std::isfinite(v)) {
+      buf_ += "null";
+      return;
+    }
+    char tmp[32];
+    const int n = std::snprintf(tmp, sizeof(tmp), "%.17g", v);
+    buf_.append(tmp, (std::size_t)n);
+  }
+
+  void string(std::string_view v) { appendString(buf_, v); }
+};
+
+// Appends `count` bits produced by bit(i) as hex digits, four bits per
+// digit in order with the first bit as the digit's most significant bit.
+// A trailing partial digit is zero-padded on the right.
+template <class BitFn>
+void append_hex_bits(std::string& out, int count, BitFn bit) {
+  static const char* kHex = "0123456789abcdef";
+  for (int i = 0; i < count; i += 4) {
+    unsigned nib = 0;
+    for (int k = 0; k < 4; ++k) nib = (nib << 1) | ((i + k < count) ? (bit(i + k) & 1u) : 0u);
+    out += kHex[nib];
+  }
+}
+
+} // namespace wa
@@ -2,11 +2,16 @@
 #include "wa_ring.hpp"
 #include <sstream>
 #include <iomanip>
+#include <cstdint>
+#include <string>
+#include <string_view>
 #include <vector>
 #include <stdexcept>
 
 namespace wa {
 
+enum class DumpFormat : u8 { Bits, Hex };
+
 class Machine {
 public:
   Machine(int rings = 10, int gearsPerRing = 360) {
@@ -25,7 +30,13 @@ public:
   void flipBit(int r, int i) { ring(r).flipBit(i); }
 
   void shiftRing(int r, Dir d, int k) { ring(r).shift(d, k); }
-  void tickAll(int k = 1) { for (auto& rg : rings_) rg.tick(k); }
+  void tickAll(int k = 1) {
+    for (auto& rg : rings_) rg.tick(k);
+    if (k > 0) ticks_ += static_cast<u64>(k);
+  }
+  // Forward ticks applied through tickAll() since construction. Monotonic and
+  // independent of the CPU, so it survives `mode` swapping CPU profiles.
+  u64 ticks() const { return ticks_; }
 
   std::string capacityString(bool twoBitsPerGearCell) const {
     const long long bits = static_cast<long long>(ringCount()) * static_cast<long long>(gearsPerRing()) * (twoBitsPerGearCell ? 2LL : 1LL);
@@ -36,18 +47,58 @@ public:
     return oss.str();
   }
 
-  std::string dumpRing(int r, int count = 64) const {
+  std::string dumpRing(int r, int count = 64, DumpFormat fmt = DumpFormat::Bits) const {
     const auto& rg = ring(r);
-    const int n = rg.gearCount();
-    const int c = (count > n) ? n : count;
-    std::ostringstream oss;
-    oss << "Ring " << r << " dir=" << to_string(rg.dir()) << " offset=" << rg.offset() << " bits:";
-    for (int i = 0; i < c; i++) oss << int(rg.getBit(i));
-    return oss.str();
+    std::string out = "Ring " + std::to_string(r) + " dir=" + to_string(rg.dir()) +
+                      " offset=" + std::to_string(rg.offset()) + (fmt == DumpFormat::Hex ? " hex:" : " bits:");
+    dumpRingTo(r, count, fmt, [&](std::string_view chunk) { out += chunk; });
+    return out;
+  }
+
+  // Streams the first `count` logical bits of ring r to sink(std::string_view)
+  // in chunks of at most kDumpChunk characters. Gears are packed 64 at a time
+  // into a limb and each limb is formatted in one go: 64 '0'/'1' characters,
+  // or 16 hex digits with the first gear in the top bit. A trailing partial
+  // hex digit is zero-padded, matching append_hex_bits.
+  static constexpr std::size_t kDumpChunk = 4096;
+
+  template <class Sink>
+  void dumpRingTo(int r, int count, DumpFormat fmt, Sink&& sink) const {
+    static const char* kHex = "0123456789abcdef";
+    char chunk[kDumpChunk + 64];
+    std::size_t used = 0;
+    std::uint64_t limb = 0;
+    int bits = 0;
+
+    auto emitLimb = [&]() {
+      // Left-align so the first gear sits in bit 63.
+      const std::uint64_t v = (bits == 64) ? limb : limb << (64 - bits);
+      if (fmt == DumpFormat::Bits) {
+        for (int i = 0; i < bits; ++i) chunk[used++] = (char)('0' + ((v >> (63 - i)) & 1u));
+      } else {
+        for (int i = 0; i < bits; i += 4) chunk[used++] = kHex[(v >> (60 - i)) & 15u];
+      }
+      if (used >= kDumpChunk) {
+        sink(std::string_view(chunk, used));
+        used = 0;
+      }
+      limb = 0;
+      bits = 0;
+    };
+
+    ring(r).forEachRun(count, [&](const Gear* g, int len) {
+      for (int i = 0; i < len; ++i) {
+        limb = (limb << 1) | (g[i].bit & 1u);
+        if (++bits == 64) emitLimb();
+      }
+    });
+    if (bits > 0) emitLimb();
+    if (used > 0) sink(std::string_view(chunk, used));
   }
 
 private:
   std::vector<Ring> rings_;
+  u64 ticks_{0};
 
   void checkRing(int r) const {
     if (r < 0 || r >= (int)rings_.size()) throw std::out_of_range("Ring out of range");
@@ -0,0 +1,67 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace wa {
+
+// Bounded multi-producer/single-consumer ring (Vyukov's sequence-stamped
+// slots). Producers claim a slot with one CAS on the head index and publish
+// it through the slot's sequence number; the single consumer never touches
+// the head. push() fails instead of blocking when the ring is full.
+// Capacity must be a power of two.
+template <class T, std::size_t Capacity>
+class MpscRing {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "MpscRing capacity must be a power of two");
+
+public:
+  MpscRing() {
+    for (std::size_t i = 0; i < Capacity; ++i) slots_[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  MpscRing(const MpscRing&) = delete;
+  MpscRing& operator=(const MpscRing&) = delete;
+
+  bool push(T&& v) {
+    std::size_t head = head_.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot& slot = slots_[head & (Capacity - 1)];
+      const std::size_t seq = slot.seq.load(std::memory_order_acquire);
+      const auto diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)head;
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) {
+          slot.value = std::move(v);
+          slot.seq.store(head + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false; // full
+      } else {
+        head = head_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool pop(T& out) {
+    Slot& slot = slots_[tail_ & (Capacity - 1)];
+    if (slot.seq.load(std::memory_order_acquire) != tail_ + 1) return false;
+    out = std::move(slot.value);
+    slot.seq.store(tail_ + Capacity, std::memory_order_release);
+    ++tail_;
+    return true;
+  }
+
+  static constexpr std::size_t capacity() { return Capacity; }
+
+private:
+  struct Slot {
+    std::atomic<std::size_t> seq{0};
+    T value{};
+  };
+
+  alignas(64) std::atomic<std::size_t> head_{0};
+  alignas(64) std::size_t tail_{0};
+  alignas(64) Slot slots_[Capacity];
+};
+
+} // namespace wa
@@ -0,0 +1,111 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace wa::audio {
+
+// Oscillator and noise kernels for the sound pack generators.
+//
+// Phase is carried in cycles and derived from the sample index (phase =
+// n * hz / sampleRate) instead of being summed sample by sample, so a block
+// starting at any n renders the same samples regardless of what came before
+// it and long renders accumulate no drift. All kernels are branch-free
+// arithmetic (no libm calls) so the block loops vectorize over samples.
+// Conditionals only ever select between already-computed values so they
+// if-convert; the build compiles wa_audio.cpp with -fno-trapping-math for
+// the same reason (it does not permit reassociation, results are unchanged).
+//
+// Error budget (absolute, against the libm reference):
+//   sin_cycles     <= 1e-9   for |phase| < 2^40 cycles
+//   exp_neg        <= 1e-8   for x in [0, 8]
+//   dnoise_cycles  <= 2e-9
+// Generator output is quantized to 16-bit (1 LSB = 3.05e-5), so rendered
+// assets differ from the scalar libm path by at most one LSB.
+
+inline constexpr int kOscBlock = 256;
+
+// Round-to-nearest via the 1.5*2^52 trick; valid for |x| < 2^51.
+inline double round_nearest(double x) {
+  constexpr double kMagic = 6755399441055744.0;
+  return (x + kMagic) - kMagic;
+}
+
+// Fractional part in [0, 1), matching std::fmod(x, 1.0) for x >= 0.
+inline double frac_cycles(double x) {
+  const double f = x - round_nearest(x);
+  return f + ((f < 0.0) ? 1.0 : 0.0);
+}
+
+// sin(2*pi*phase) with phase in cycles.
+inline double sin_cycles(double phase) {
+  const double x = phase - round_nearest(phase);              // [-0.5, 0.5]
+  const double a = std::fabs(x);                              // [0, 0.5]
+  const double m = 0.5 - a;
+  const double b = (a < m) ? a : m;                           // [0, 0.25]
+  const double y = b * 6.28318530717958647692;                // [0, pi/2]
+  const double y2 = y * y;
+  // Taylor series to y^15; truncation error < 7e-12 on [0, pi/2].
+  double p = -7.6471637318198164759e-13;
+  p = p * y2 + 1.6059043836821614599e-10;
+  p = p * y2 - 2.5052108385441718775e-08;
+  p = p * y2 + 2.7557319223985890653e-06;
+  p = p * y2 - 1.9841269841269841270e-04;
+  p = p * y2 + 8.3333333333333333333e-03;
+  p = p * y2 - 1.6666666666666666667e-01;
+  const double s = y + y * y2 * p;
+  return std::copysign(s, x);
+}
+
+// exp(-x) for x in [0, 8], evaluated as (exp(-x/8))^8.
+inline double exp_neg(double x) {
+  const double u = x * 0.125;
+  double p = 1.0 / 3628800.0;
+  p = p * -u + 1.0 / 362880.0;
+  p = p * -u + 1.0 / 40320.0;
+  p = p * -u + 1.0 / 5040.0;
+  p = p * -u + 1.0 / 720.0;
+  p = p * -u + 1.0 / 120.0;
+  p = p * -u + 1.0 / 24.0;
+  p = p * -u + 1.0 / 6.0;
+  p = p * -u + 0.5;
+  p = p * -u + 1.0;
+  p = p * -u + 1.0;
+  p *= p;
+  p *= p;
+  return p * p;
+}
+
+// Decay envelope exp(-phase*rate) inside [0, window), zero past it.
+// window*rate must stay within exp_neg's [0, 8] range.
+inline double decay_window(double phase, double window, double rate) {
+  const double p = (phase < window) ? phase : window;
+  const double gate = (phase < window) ? 1.0 : 0.0;
+  return gate * exp_neg(p * rate);
+}
+
+// Deterministic "gear grit": three inharmonic partials at 937/1433/2117 Hz.
+// `t` is time in seconds.
+inline double dnoise_cycles(double t) {
+  return 0.55 * sin_cycles(937.0 * t) + 0.35 * sin_cycles(1433.0 * t) + 0.20 * sin_cycles(2117.0 * t);
+}
+
+// Converts a block of [-1, 1] samples to clamped 16-bit PCM.
+inline void quantize16_block(const double* in, std::int16_t* out, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i) {
+    const double lo = (in[i] < -1.0) ? -1.0 : in[i];
+    const double s = (lo > 1.0) ? 1.0 : lo;
+    out[i] = static_cast<std::int16_t>(round_nearest(s * 32767.0));
+  }
+}
+
+// Converts a block of [-1, 1] samples to clamped 24-bit PCM (in int32).
+inline void quantize24_block(const double* in, std::int32_t* out, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i) {
+    const double lo = (in[i] < -1.0) ? -1.0 : in[i];
+    const double s = (lo > 1.0) ? 1.0 : lo;
+    out[i] = static_cast<std::int32_t>(round_nearest(s * 8388607.0));
+  }
+}
+
+} // namespace wa::audio
@@ -0,0 +1,48 @@
+#pragma once
+#include "wa_mpsc.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+namespace wa {
+
+// Moves text off the calling threads: write() hands a chunk to a lock-free
+// MPSC ring and a background thread drains it into `os` in large batched
+// writes. flush() blocks until every chunk written before it has reached
+// the stream and the stream has been flushed.
+class OutputWriter {
+public:
+  explicit OutputWriter(std::ostream& os);
+  ~OutputWriter();
+
+  OutputWriter(const OutputWriter&) = delete;
+  OutputWriter& operator=(const OutputWriter&) = delete;
+
+  // Queues a chunk; spins (yielding) only if the ring is full.
+  void write(std::string&& chunk);
+  void flush();
+
+  std::uint64_t chunksWritten() const { return written_.load(std::memory_order_acquire); }
+
+private:
+  static constexpr std::size_t kRingSize = 1024;
+  static constexpr std::size_t kBatchBytes = 256 * 1024;
+
+  std::ostream& os_;
+  MpscRing<std::string, kRingSize> ring_;
+  std::atomic<std::uint64_t> queued_{0};
+  std::atomic<std::uint64_t> written_{0};
+  std::atomic<bool> stop_{false};
+  std::mutex mu_;
+  std::condition_variable wake_;
+  std::condition_variable drained_;
+  std::thread thread_;
+
+  void run();
+};
+
+} // namespace wa
@@ -49,6 +49,19 @@ public:
   void setBit(int logicalIndex, u8 v) { gears_[mapIndex(logicalIndex)].bit = (v & 1u); }
   void flipBit(int logicalIndex) { setBit(logicalIndex, static_cast<u8>(getBit(logicalIndex) ^ 1u)); }
 
+  // Visits logical gears [0, count) as at most two contiguous physical runs,
+  // fn(const Gear* first, int len), so bulk readers skip per-gear mapIndex.
+  template <class Fn>
+  void forEachRun(int count, Fn fn) const {
+    const int n = gearCount();
+    if (count > n) count = n;
+    if (count <= 0) return;
+    const int start = mapIndex(0);
+    const int head = (count < n - start) ? count : n - start;
+    fn(gears_.data() + start, head);
+    if (head < count) fn(gears_.data(), count - head);
+  }
+
   const Gear& gearAtLogical(int logicalIndex) const { return gears_[mapIndex(logicalIndex)]; }
   Gear&       gearAtLogical(int logicalIndex)       { return gears_[mapIndex(logicalIndex)]; }
 
@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace wa {
+
+struct ServerConfig {
+  std::string socketPath{"/tmp/wa_console.sock"};
+  unsigned workers{4};        // command execution threads
+  int rings{10};              // geometry of each session's Machine
+  int gearsPerRing{360};
+  std::size_t maxSessions{256};
+  std::size_t maxLineBytes{64 * 1024}; // longer unterminated input drops the client
+  std::size_t maxOutputBytes{1 << 20}; // unsent output above this pauses the session
+};
+
+// Multi-session console server on a Unix domain socket (Linux only).
+//
+// One I/O thread owns every socket: it accepts clients and reads/writes
+// them non-blocking through epoll. Each client gets its own Machine, CPU
+// and Console. Complete input lines are handed to a fixed worker pool; a
+// session is scheduled on at most one worker at a time, so its commands run
+// in order while different sessions run in parallel. Workers hand output
+// back to the I/O thread through an eventfd. A client that stops reading is
+// paused once its unsent output passes maxOutputBytes: no further commands
+// run and its socket is not read until the backlog drains.
+class ConsoleServer {
+public:
+  explicit ConsoleServer(ServerConfig cfg = {});
+  ~ConsoleServer();
+
+  ConsoleServer(const ConsoleServer&) = delete;
+  ConsoleServer& operator=(const ConsoleServer&) = delete;
+
+  // Binds the socket and starts the threads. A stale socket file at the path
+  // is replaced; any other file, or a socket a live server answers on, makes
+  // start() fail. Returns false also on non-Linux builds.
+  bool start();
+  // Disconnects all clients, joins the threads and removes the socket file.
+  void stop();
+
+  bool running() const { return running_.load(std::memory_order_acquire); }
+  std::size_t sessions() const { return sessionCount_.load(std::memory_order_relaxed); }
+  std::uint64_t commandsExecuted() const { return commands_.load(std::memory_order_relaxed); }
+
+private:
+  struct Impl;
+
+  ServerConfig cfg_;
+  std::unique_ptr<Impl> impl_;
+  std::atomic<bool> running_{false};
+  std::atomic<std::size_t> sessionCount_{0};
+  std::atomic<std::uint64_t> commands_{0};
+};
+
+} // namespace wa
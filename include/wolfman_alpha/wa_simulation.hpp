@@ -0,0 +1,84 @@
+#pragma once
+#include "wa_components.hpp"
+#include "wa_mpsc.hpp"
+#include "wa_triple_buffer.hpp"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace wa {
+
+// Compact view of a MechanicalComputer, copied out by the simulation thread.
+struct MachineSnapshot {
+  static constexpr int kMaxWords = 8;
+
+  std::uint64_t seq{0};   // publish count; 0 = nothing published yet
+  std::uint64_t steps{0}; // CPU steps run by the simulation thread
+  std::uint64_t ticks{0};
+  bool clockRunning{false};
+  bool halted{false};
+  bool freeRun{false};
+  std::uint64_t ip{0};
+  int regCount{0};
+  std::array<int, kMaxWords> regIndex{};
+  std::array<u64, kMaxWords> regs{};
+  int ramCount{0};
+  std::array<int, kMaxWords> ramAddr{};
+  std::array<u64, kMaxWords> ram{};
+};
+
+struct SimulationConfig {
+  std::vector<int> registers{0, 1, 2, 3}; // copied into each snapshot (max 8)
+  std::vector<int> ramWords{0, 1, 2, 3};  // RAM addresses likewise
+  std::uint64_t stepsPerSlice{4096};      // free-run steps between publishes
+};
+
+// Runs a MechanicalComputer on its own thread. In free-run mode the thread
+// steps the CPU (one clock tick per step) as fast as it can, publishing a
+// MachineSnapshot through a triple buffer after every slice; a UI thread
+// reads the latest one without locking. While the thread runs, it owns the
+// machine: other threads change it only through post().
+class SimulationThread {
+public:
+  explicit SimulationThread(MechanicalComputer& mech, SimulationConfig cfg = {});
+  ~SimulationThread();
+
+  SimulationThread(const SimulationThread&) = delete;
+  SimulationThread& operator=(const SimulationThread&) = delete;
+
+  void start();
+  void stop(); // joins; the machine is the caller's again afterwards
+  bool running() const { return thread_.joinable(); }
+
+  void setFreeRun(bool on) { freeRun_.store(on, std::memory_order_relaxed); }
+  bool freeRun() const { return freeRun_.load(std::memory_order_relaxed); }
+
+  // Runs fn on the simulation thread before its next slice; a snapshot is
+  // published afterwards. Returns false if the command queue is full.
+  bool post(std::function<void(MechanicalComputer&)> fn);
+
+  // Latest published snapshot. Single reader thread only.
+  const MachineSnapshot& snapshot() {
+    snapshots_.update();
+    return snapshots_.readBuffer();
+  }
+
+private:
+  MechanicalComputer& mech_;
+  SimulationConfig cfg_;
+  std::thread thread_;
+  std::atomic<bool> stop_{false};
+  std::atomic<bool> freeRun_{false};
+  MpscRing<std::function<void(MechanicalComputer&)>, 256> commands_;
+  TripleBuffer<MachineSnapshot> snapshots_;
+  std::uint64_t steps_{0};
+  std::uint64_t published_{0};
+
+  void loop();
+  void publish();
+};
+
+} // namespace wa
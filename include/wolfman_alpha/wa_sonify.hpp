@@ -0,0 +1,62 @@
+#pragma once
+#include "wa_audio.hpp"
+#include "wa_sound_event.hpp"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace wa::audio {
+
+struct SonifyConfig {
+  int sampleRate{44100};
+  double clockHz{24.0}; // mechanical ticks per second of rendered audio
+  double gain{0.8};
+  SampleFormat format{SampleFormat::Pcm16};
+};
+
+// Drains a SoundEventQueue on its own thread and mixes one voice per event
+// into a mono WAV stream: Instr -> ratchet tick, RingShift -> gear whirr,
+// Zodiac -> pulse, Halt -> drone tail. An event on tick T starts exactly at
+// sample (T - firstTick) * sampleRate / clockHz; a tick before the first one
+// (a producer whose clock went backwards) is placed at the current sample.
+class EventSonifier {
+public:
+  explicit EventSonifier(SoundEventQueue& queue, SonifyConfig cfg = {});
+  ~EventSonifier();
+
+  EventSonifier(const EventSonifier&) = delete;
+  EventSonifier& operator=(const EventSonifier&) = delete;
+
+  bool start(const std::string& wavPath);
+  // Drains what is left in the queue, renders voice tails and closes the file.
+  void stop();
+
+  bool running() const { return thread_.joinable(); }
+  u64 eventsRendered() const { return rendered_.load(std::memory_order_relaxed); }
+  u64 samplesWritten() const { return written_; }
+
+private:
+  struct Voice {
+    const std::vector<double>* grain;
+    u64 start;
+  };
+
+  SoundEventQueue& queue_;
+  SonifyConfig cfg_;
+  std::vector<double> tick_, whirr_, pulse_, halt_;
+  std::vector<Voice> active_;
+  WavStreamWriter out_;
+  u64 written_{0};
+  u64 originTick_{0};
+  bool haveOrigin_{false};
+  std::atomic<bool> stop_{false};
+  std::atomic<u64> rendered_{0};
+  std::thread thread_;
+
+  void run();
+  void handle(const SoundEvent& ev);
+  void renderUntil(u64 end);
+};
+
+} // namespace wa::audio
@@ -0,0 +1,42 @@
+#pragma once
+#include "wa_spsc.hpp"
+#include "wa_types.hpp"
+
+namespace wa {
+
+enum class SoundEventKind : u8 {
+  Instr,     // detail = opcode
+  RingShift, // detail = ring index, 0xFF for all rings
+  Zodiac,    // detail = active glyph
+  Halt
+};
+
+// Compact record pushed by the CPU cores; `tick` is the mechanical clock tick
+// the event happened on (Machine::ticks() for CpuBase, MechanicalClock for
+// GearCPUCore), which the sonifier maps to an exact sample index.
+struct SoundEvent {
+  u64 tick{0};
+  SoundEventKind kind{SoundEventKind::Instr};
+  u8 detail{0};
+};
+
+using SoundEventQueue = SpscRing<SoundEvent, 4096>;
+
+// Producer-side handle: pushes never block, and events that do not fit are
+// counted instead of waited for.
+class SoundEventSink {
+public:
+  explicit SoundEventSink(SoundEventQueue* q = nullptr) : q_(q) {}
+
+  explicit operator bool() const { return q_ != nullptr; }
+  void emit(u64 tick, SoundEventKind kind, u8 detail = 0) {
+    if (!q_->push(SoundEvent{tick, kind, detail})) dropped_++;
+  }
+  u64 dropped() const { return dropped_; }
+
+private:
+  SoundEventQueue* q_{nullptr};
+  u64 dropped_{0};
+};
+
+} // namespace wa
@@ -0,0 +1,54 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace wa {
+
+// Bounded single-producer/single-consumer ring. push() and pop() never block
+// or allocate; a full ring rejects the push and the producer decides what to
+// drop. Capacity must be a power of two.
+template <class T, std::size_t Capacity>
+class SpscRing {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+  bool push(const T& v) {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tailCache_ == Capacity) {
+      tailCache_ = tail_.load(std::memory_order_acquire);
+      if (head - tailCache_ == Capacity) return false;
+    }
+    slots_[head & (Capacity - 1)] = v;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T& out) {
+    const std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == headCache_) {
+      headCache_ = head_.load(std::memory_order_acquire);
+      if (tail == headCache_) return false;
+    }
+    out = slots_[tail & (Capacity - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const {
+    return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+  }
+
+  static constexpr std::size_t capacity() { return Capacity; }
+
+private:
+  // Producer and consumer indices live on separate cache lines, each next to
+  // the cached copy of the other side's index that only its owner touches.
+  alignas(64) std::atomic<std::size_t> head_{0};
+  std::size_t tailCache_{0};
+  alignas(64) std::atomic<std::size_t> tail_{0};
+  std::size_t headCache_{0};
+  alignas(64) std::array<T, Capacity> slots_{};
+};
+
+} // namespace wa
@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+namespace wa::audio {
+
+using SynthNode = int;
+
+// Block-based synthesis graph. Nodes are added in dependency order (every
+// input must already exist) and each produces one block of samples per
+// process() call. The graph's result is the node passed to setOutput() (or
+// the last node added); setOutput(left, right) makes the graph stereo.
+// All node kernels are the wa_osc.hpp primitives, so a graph renders the
+// same samples as the equivalent hand-written expression.
+class SynthGraph {
+public:
+  explicit SynthGraph(int sampleRate = 44100) : sampleRate_(sampleRate) {}
+
+  // Sources
+  SynthNode constant(double v);
+  SynthNode sine(double hz);                                  // sin(2*pi*hz*t)
+  SynthNode sine(SynthNode freq, double freqScale = 1.0);     // sin(2*pi*(freqScale*freq)*t)
+  SynthNode noise();                                          // dnoise_cycles(t)
+  SynthNode envelope(double hz, double window, double rate);  // decay_window(frac(hz*t), window, rate)
+  SynthNode stepSeq(double hz, std::vector<double> values);   // values[floor(hz*t) % size]
+
+  // Combinators
+  SynthNode affine(SynthNode in, double gain, double bias);   // gain*in + bias
+  SynthNode mul(SynthNode a, SynthNode b, double gain = 1.0); // gain*a*b
+  SynthNode mix(std::initializer_list<std::pair<SynthNode, double>> terms); // sum gain_i*in_i
+  SynthNode mix(const std::vector<SynthNode>& in, const std::vector<double>& gains);
+  SynthNode limit(SynthNode in, double ceiling = 1.0);        // clamp to [-ceiling, ceiling]
+
+  void setOutput(SynthNode n) { output_ = n; outputRight_ = -1; }
+  void setOutput(SynthNode left, SynthNode right);
+  SynthNode output() const { return output_; }
+  int channels() const { return outputRight_ < 0 ? 1 : 2; }
+  int sampleRate() const { return sampleRate_; }
+  std::size_t nodeCount() const { return nodes_.size(); }
+
+  // Scratch space for one process() call; reuse across blocks to avoid
+  // reallocating. Safe to share a graph between threads with one scratch each.
+  struct Scratch {
+    std::vector<double> buffers;
+  };
+
+  // Renders frames [n0, n0+count), count <= kOscBlock, into `out`
+  // (channels() interleaved values per frame).
+  void process(std::int64_t n0, int count, double* out, Scratch& scratch) const;
+
+private:
+  enum class Op : std::uint8_t { Const, SineHz, SineIn, Noise, Envelope, StepSeq, Affine, Mul, Mix, Limit };
+
+  struct Node {
+    Op op{Op::Const};
+    SynthNode a{-1};
+    SynthNode b{-1};
+    int first{0}; // first entry in inputs_/gains_ (Mix) or table_ (StepSeq)
+    int count{0};
+    double p0{0.0};
+    double p1{0.0};
+    double p2{0.0};
+  };
+
+  int sampleRate_{44100};
+  SynthNode output_{-1};
+  SynthNode outputRight_{-1};
+  std::vector<Node> nodes_;
+  std::vector<SynthNode> inputs_;
+  std::vector<double> gains_;
+  std::vector<double> table_;
+
+  SynthNode add(const Node& n);
+  void checkInput(SynthNode n) const;
+};
+
+} // namespace wa::audio
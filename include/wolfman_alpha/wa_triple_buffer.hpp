@@ -0,0 +1,40 @@
+#pragma once
+#include <atomic>
+
+namespace wa {
+
+// Lock-free single-writer/single-reader triple buffer. The writer fills
+// writeBuffer() and publish()es it; the reader calls update() and then
+// reads readBuffer(), which always holds the latest complete value. Neither
+// side ever waits: the three slots rotate through one atomic exchange, and a
+// slow reader simply skips intermediate values.
+template <class T>
+class TripleBuffer {
+public:
+  TripleBuffer() = default;
+  TripleBuffer(const TripleBuffer&) = delete;
+  TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+  // Writer side.
+  T& writeBuffer() { return slots_[back_]; }
+  void publish() { back_ = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel) & kIndex; }
+
+  // Reader side. Returns true if a newer value was swapped in.
+  bool update() {
+    if ((middle_.load(std::memory_order_relaxed) & kFresh) == 0) return false;
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndex;
+    return true;
+  }
+  const T& readBuffer() const { return slots_[front_]; }
+
+private:
+  static constexpr unsigned kIndex = 3;
+  static constexpr unsigned kFresh = 4; // middle slot holds an unread value
+
+  T slots_[3]{};
+  alignas(64) std::atomic<unsigned> middle_{1};
+  alignas(64) unsigned back_{0};  // writer only
+  alignas(64) unsigned front_{2}; // reader only
+};
+
+} // namespace wa
@@ -0,0 +1,54 @@
+#pragma once
+#include "wa_audio.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace wa::audio {
+
+// Read-only view of a PCM16/PCM24/Float32 WAV file. On POSIX the file is
+// memory-mapped and samples are decoded straight out of the mapping into
+// caller buffers; elsewhere (or if mmap fails) the file is read once into
+// an owned buffer. Either way no decoded copy of the whole file is made.
+class WavView {
+public:
+  WavView() = default;
+  explicit WavView(const std::string& path) { open(path); }
+  ~WavView() { close(); }
+
+  WavView(const WavView&) = delete;
+  WavView& operator=(const WavView&) = delete;
+  WavView(WavView&& other) noexcept;
+  WavView& operator=(WavView&& other) noexcept;
+
+  // Maps `path` and parses its RIFF chunks; false on I/O or format errors.
+  bool open(const std::string& path);
+  void close();
+
+  bool isOpen() const { return data_ != nullptr; }
+  bool mapped() const { return mapLen_ != 0; }
+  const WavFormat& format() const { return fmt_; }
+  std::uint64_t frames() const { return frames_; }
+  double seconds() const { return fmt_.sampleRate > 0 ? (double)frames_ / fmt_.sampleRate : 0.0; }
+
+  // Decodes `count` frames of one channel starting at `frame0` into `out`
+  // as [-1, 1] doubles. channel = -1 averages all channels. Reads past the
+  // end are zero-filled. Throws std::out_of_range for a bad channel.
+  void decode(std::uint64_t frame0, std::size_t count, int channel, double* out) const;
+
+  // Raw sample bytes (frames * channels * bytesPerSample).
+  const unsigned char* data() const { return data_; }
+  std::size_t dataBytes() const { return dataBytes_; }
+
+private:
+  WavFormat fmt_{};
+  std::uint64_t frames_{0};
+  const unsigned char* data_{nullptr};
+  std::size_t dataBytes_{0};
+  void* map_{nullptr};
+  std::size_t mapLen_{0};
+  std::vector<unsigned char> owned_;
+};
+
+} // namespace wa::audio
@@ -27,4 +27,16 @@ inline Zodiac13 activeGlyphFromOffset(int offset, int gearCount=360) {
   return glyphAtIndex(idx, gearCount);
 }
 
+// Inverse of glyphAtIndex: glyph g covers gear indices [first, last], where
+// first = ceil(g*n/13). Returns false if the ring is too small for g to
+// cover any gear (n < 13).
+inline bool glyphIndexRange(Zodiac13 g, int gearCount, int& first, int& last) {
+  if (gearCount <= 0) return false;
+  const long long n = gearCount;
+  const long long gi = (long long)g;
+  first = (int)((gi * n + ZODIAC_COUNT - 1) / ZODIAC_COUNT);
+  last = (int)(((gi + 1) * n + ZODIAC_COUNT - 1) / ZODIAC_COUNT) - 1;
+  return first <= last;
+}
+
 } // namespace wa
@@ -0,0 +1,230 @@
+#include "wolfman_alpha/wa_analysis.hpp"
+#include "wolfman_alpha/wa_math.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace wa::audio {
+
+namespace {
+
+constexpr int kOnsetHistory = 8;
+constexpr int kOnsetRefractoryHops = 4;
+
+std::int8_t to_db(double power) {
+  const double db = 10.0 * std::log10(std::max(power, 1e-12));
+  return (std::int8_t)std::clamp(std::lround(db), -120L, 20L);
+}
+
+} // namespace
+
+Fft::Fft(int size) : n_(size) {
+  if (size < 2 || (size & (size - 1)) != 0) throw std::invalid_argument("FFT size must be a power of two >= 2");
+  twiddle_.resize((std::size_t)size / 2);
+  for (int k = 0; k < size / 2; ++k) twiddle_[(std::size_t)k] = std::polar(1.0, -2.0 * math::PI * k / size);
+
+  int bits = 0;
+  while ((1 << bits) < size) ++bits;
+  bitrev_.resize((std::size_t)size);
+  for (int i = 0; i < size; ++i) {
+    int r = 0;
+    for (int b = 0; b < bits; ++b) r |= ((i >> b) & 1) << (bits - 1 - b);
+    bitrev_[(std::size_t)i] = r;
+  }
+
+  window_.resize((std::size_t)size);
+  double sum = 0.0;
+  for (int i = 0; i < size; ++i) {
+    window_[(std::size_t)i] = 0.5 - 0.5 * std::cos(2.0 * math::PI * i / size);
+    sum += window_[(std::size_t)i];
+  }
+  windowGain_ = 2.0 / sum;
+}
+
+void Fft::forward(std::complex<double>* x) const {
+  for (int i = 0; i < n_; ++i) {
+    const int j = bitrev_[(std::size_t)i];
+    if (i < j) std::swap(x[i], x[j]);
+  }
+  for (int len = 2; len <= n_; len <<= 1) {
+    const int half = len / 2;
+    const int stride = n_ / len;
+    for (int i = 0; i < n_; i += len) {
+      for (int k = 0; k < half; ++k) {
+        const std::complex<double> t = twiddle_[(std::size_t)(k * stride)] * x[i + k + half];
+        x[i + k + half] = x[i + k] - t;
+        x[i + k] += t;
+      }
+    }
+  }
+}
+
+void Fft::magnitudes(const double* in, double* out) const {
+  std::vector<std::complex<double>> buf((std::size_t)n_);
+  for (int i = 0; i < n_; ++i) buf[(std::size_t)i] = in[i] * window_[(std::size_t)i];
+  forward(buf.data());
+  for (int k = 0; k <= n_ / 2; ++k) out[k] = std::abs(buf[(std::size_t)k]) * windowGain_;
+}
+
+std::vector<double> spectrum(const WavView& wav, std::uint64_t frame0, int size) {
+  const Fft fft(size);
+  std::vector<double> samples((std::size_t)size);
+  wav.decode(frame0, samples.size(), -1, samples.data());
+  std::vector<double> mags((std::size_t)size / 2 + 1);
+  fft.magnitudes(samples.data(), mags.data());
+  return mags;
+}
+
+std::vector<LevelWindow> window_levels(const WavView& wav, int windowFrames) {
+  if (windowFrames <= 0) throw std::invalid_argument("windowFrames must be > 0");
+  std::vector<LevelWindow> out;
+  std::vector<double> buf((std::size_t)windowFrames);
+  for (std::uint64_t f = 0; f < wav.frames(); f += (std::uint64_t)windowFrames) {
+    const std::size_t n = (std::size_t)std::min<std::uint64_t>((std::uint64_t)windowFrames, wav.frames() - f);
+    LevelWindow w;
+    w.frame = f;
+    double sq = 0.0;
+    for (int c = 0; c < wav.format().channels; ++c) {
+      wav.decode(f, n, c, buf.data());
+      for (std::size_t i = 0; i < n; ++i) {
+        sq += buf[i] * buf[i];
+        w.peak = std::max(w.peak, std::fabs(buf[i]));
+      }
+    }
+    w.rms = std::sqrt(sq / (double)(n * (std::size_t)wav.format().channels));
+    out.push_back(w);
+  }
+  return out;
+}
+
+std::vector<std::uint64_t> detect_onsets(const WavView& wav, int hopFrames, double ratio, double floorRms) {
+  if (hopFrames <= 0) throw std::invalid_argument("hopFrames must be > 0");
+  std::vector<std::uint64_t> onsets;
+  std::vector<double> buf((std::size_t)hopFrames);
+  double history[kOnsetHistory] = {};
+  double historySum = 0.0;
+  long long hop = 0;
+  long long lastOnset = -kOnsetRefractoryHops;
+  const double floorEnergy = floorRms * floorRms;
+
+  for (std::uint64_t f = 0; f < wav.frames(); f += (std::uint64_t)hopFrames, ++hop) {
+    wav.decode(f, buf.size(), -1, buf.data());
+    double e = 0.0;
+    for (double s : buf) e += s * s;
+    e /= (double)buf.size();
+
+    const long long seen = std::min<long long>(hop, kOnsetHistory);
+    const double mean = seen > 0 ? historySum / (double)seen : 0.0;
+    if (e > floorEnergy && e > ratio * mean && hop - lastOnset >= kOnsetRefractoryHops) {
+      onsets.push_back(f);
+      lastOnset = hop;
+    }
+    double& slot = history[hop % kOnsetHistory];
+    historySum += e - slot;
+    slot = e;
+  }
+  return onsets;
+}
+
+AudioFingerprint fingerprint(const WavView& wav) {
+  AudioFingerprint fp;
+  fp.sampleRate = wav.format().sampleRate;
+  fp.channels = wav.format().channels;
+  fp.frames = wav.frames();
+  fp.onsets = (std::uint32_t)detect_onsets(wav).size();
+
+  // Log-spaced band edges (in bins) from 40 Hz up to Nyquist.
+  const int half = kFingerprintWindow / 2;
+  const double nyquist = 0.5 * fp.sampleRate;
+  int edges[kFingerprintBands + 1];
+  for (int b = 0; b <= kFingerprintBands; ++b) {
+    const double hz = 40.0 * std::pow(nyquist / 40.0, (double)b / kFingerprintBands);
+    edges[b] = std::clamp((int)std::lround(hz / nyquist * half), 1, half + 1);
+  }
+
+  const Fft fft(kFingerprintWindow);
+  std::vector<double> buf(kFingerprintWindow);
+  std::vector<double> mags((std::size_t)half + 1);
+  for (std::uint64_t f = 0; f < wav.frames(); f += kFingerprintWindow) {
+    wav.decode(f, buf.size(), -1, buf.data());
+    double sq = 0.0;
+    for (double s : buf) sq += s * s;
+    fp.db.push_back(to_db(sq / kFingerprintWindow));
+
+    fft.magnitudes(buf.data(), mags.data());
+    for (int b = 0; b < kFingerprintBands; ++b) {
+      double power = 0.0;
+      for (int k = edges[b]; k < edges[b + 1]; ++k) power += mags[(std::size_t)k] * mags[(std::size_t)k];
+      fp.db.push_back(to_db(power));
+    }
+  }
+  return fp;
+}
+
+bool fingerprints_match(const AudioFingerprint& a, const AudioFingerprint& b, int tolDb) {
+  if (a.sampleRate != b.sampleRate || a.channels != b.channels || a.frames != b.frames) return false;
+  if (a.onsets != b.onsets || a.db.size() != b.db.size()) return false;
+  for (std::size_t i = 0; i < a.db.size(); ++i) {
+    if (std::abs((int)a.db[i] - (int)b.db[i]) > tolDb) return false;
+  }
+  return true;
+}
+
+// "<rate> <channels> <frames> <onsets> <hex dB cells>"
+std::string AudioFingerprint::toString() const {
+  std::string s = std::to_string(sampleRate) + ' ' + std::to_string(channels) + ' ' +
+                  std::to_string(frames) + ' ' + std::to_string(onsets) + ' ';
+  static const char* kHex = "0123456789abcdef";
+  for (std::int8_t v : db) {
+    const auto u = (std::uint8_t)v;
+    s += kHex[u >> 4];
+    s += kHex[u & 15];
+  }
+  return s;
+}
+
+bool AudioFingerprint::parse(const std::string& s, AudioFingerprint& out) {
+  std::istringstream iss(s);
+  AudioFingerprint fp;
+  std::string hex;
+  if (!(iss >> fp.sampleRate >> fp.channels >> fp.frames >> fp.onsets >> hex)) return false;
+  if (hex.size() % 2 != 0) return false;
+  for (std::size_t i = 0; i < hex.size(); i += 2) {
+    unsigned v = 0;
+    if (std::sscanf(hex.c_str() + i, "%2x", &v) != 1) return false;
+    fp.db.push_back((std::int8_t)(std::uint8_t)v);
+  }
+  out = std::move(fp);
+  return true;
+}
+
+std::map<std::string, AudioFingerprint> load_fingerprints(const std::string& path) {
+  std::map<std::string, AudioFingerprint> out;
+  std::ifstream f(path);
+  for (std::string line; std::getline(f, line);) {
+    const auto sp = line.find(' ');
+    if (sp == std::string::npos) continue;
+    AudioFingerprint fp;
+    if (AudioFingerprint::parse(line.substr(sp + 1), fp)) out[line.substr(0, sp)] = std::move(fp);
+  }
+  return out;
+}
+
+bool save_fingerprints(const std::string& path, const std::map<std::string, AudioFingerprint>& prints) {
+  const std::string tmp = path + ".tmp";
+  {
+    std::ofstream f(tmp, std::ios::trunc);
+    if (!f) return false;
+    for (const auto& kv : prints) f << kv.first << ' ' << kv.second.toString() << '\n';
+    if (!f) return false;
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp, path, ec);
+  return !ec;
+}
+
+} // namespace wa::audio
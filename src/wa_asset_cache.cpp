@@ -0,0 +1,116 @@
+#include "wolfman_alpha/wa_asset_cache.hpp"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <map>
+
+namespace wa::audio {
+
+namespace {
+
+struct ManifestEntry {
+  std::uint64_t key{0};
+  std::uint64_t sum{0};
+  std::uint64_t bytes{0};
+};
+
+using Manifest = std::map<std::string, ManifestEntry>;
+
+// Manifest lines: "<key hex> <checksum hex> <bytes> <path>".
+Manifest load_manifest(const std::string& path) {
+  Manifest out;
+  std::ifstream f(path);
+  for (std::string line; std::getline(f, line);) {
+    std::istringstream iss(line);
+    ManifestEntry e;
+    std::string file;
+    if (!(iss >> std::hex >> e.key >> e.sum >> std::dec >> e.bytes)) continue;
+    iss >> std::ws;
+    std::getline(iss, file);
+    if (!file.empty()) out[file] = e;
+  }
+  return out;
+}
+
+bool save_manifest(const std::string& path, const Manifest& m) {
+  const std::string tmp = path + ".tmp";
+  {
+    std::ofstream f(tmp, std::ios::trunc);
+    if (!f) return false;
+    for (const auto& kv : m) {
+      f << std::hex << kv.second.key << ' ' << kv.second.sum << ' ' << std::dec << kv.second.bytes << ' ' << kv.first << '\n';
+    }
+    if (!f) return false;
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp, path, ec);
+  return !ec;
+}
+
+bool checksum_file(const std::string& path, std::uint64_t& sum, std::uint64_t& bytes) {
+  std::ifstream f(path, std::ios::binary);
+  if (!f) return false;
+  const std::string data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+  bytes = data.size();
+  sum = fnv1a64(data.data(), data.size());
+  return true;
+}
+
+} // namespace
+
+std::uint64_t fnv1a64(const void* data, std::size_t size, std::uint64_t seed) {
+  const auto* p = static_cast<const unsigned char*>(data);
+  std::uint64_t h = seed;
+  for (std::size_t i = 0; i < size; ++i) {
+    h ^= p[i];
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
+
+std::uint64_t sound_job_key(const SoundJob& job) {
+  char buf[200];
+  const int n = std::snprintf(buf, sizeof(buf), "v=%d;kind=%d;seconds=%.17g;rate=%.17g;sr=%d;ch=%d;fmt=%d;file=",
+                              kSoundCodeVersion, static_cast<int>(job.kind), job.seconds, job.rate,
+                              job.format.sampleRate, job.format.channels, static_cast<int>(job.format.format));
+  const std::string name = std::filesystem::path(job.path).filename().string();
+  return fnv1a64(name.data(), name.size(), fnv1a64(buf, static_cast<std::size_t>(n)));
+}
+
+std::vector<AssetStatus> sync_sound_pack(const std::vector<SoundJob>& jobs, const std::string& manifestPath, unsigned threads) {
+  Manifest manifest = load_manifest(manifestPath);
+  std::vector<AssetStatus> status(jobs.size(), AssetStatus::Failed);
+  std::vector<SoundJob> stale;
+  std::vector<std::size_t> staleIndex;
+
+  for (std::size_t i = 0; i < jobs.size(); ++i) {
+    const auto it = manifest.find(jobs[i].path);
+    std::uint64_t sum = 0, bytes = 0;
+    if (it != manifest.end() && it->second.key == sound_job_key(jobs[i]) &&
+        checksum_file(jobs[i].path, sum, bytes) && sum == it->second.sum && bytes == it->second.bytes) {
+      status[i] = AssetStatus::Cached;
+    } else {
+      stale.push_back(jobs[i]);
+      staleIndex.push_back(i);
+    }
+  }
+  if (stale.empty()) return status;
+
+  const auto written = render_sound_pack(stale, threads);
+  for (std::size_t s = 0; s < stale.size(); ++s) {
+    ManifestEntry e;
+    e.key = sound_job_key(stale[s]);
+    if (written[s] && checksum_file(stale[s].path, e.sum, e.bytes)) {
+      manifest[stale[s].path] = e;
+      status[staleIndex[s]] = AssetStatus::Rendered;
+    } else {
+      manifest.erase(stale[s].path);
+    }
+  }
+  save_manifest(manifestPath, manifest);
+  return status;
+}
+
+} // namespace wa::audio
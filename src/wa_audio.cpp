@@ -1,9 +1,14 @@
 #include "wolfman_alpha/wa_audio.hpp"
+#include "wolfman_alpha/wa_osc.hpp"
+#include "wolfman_alpha/wa_synth.hpp"
 #include <vector>
 #include <cstdint>
 #include <cmath>
 #include <fstream>
 #include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
 
 namespace wa::audio {
 
@@ -18,13 +23,9 @@ static void write_u16(std::ofstream& f, std::uint16_t v) {
   f.put((char)((v >> 8) & 0xFF));
 }
 
-static bool write_wav_mono16(const std::string& path, const std::vector<std::int16_t>& pcm, int sampleRate) {
-  std::ofstream f(path, std::ios::binary);
-  if (!f) return false;
-
-  const int channels = 1;
-  const int bitsPerSample = 16;
-  const std::uint32_t dataBytes = (std::uint32_t)(pcm.size() * sizeof(std::int16_t));
+static void write_wav_header(std::ofstream& f, const WavFormat& fmt, std::uint32_t dataBytes) {
+  const int channels = fmt.channels;
+  const int bitsPerSample = fmt.bytesPerSample() * 8;
 
   f.write("RIFF", 4);
   write_u32(f, 36 + dataBytes);
@@ -32,164 +33,314 @@ static bool write_wav_mono16(const std::string& path, const std::vector<std::int
 
   f.write("fmt ", 4);
   write_u32(f, 16);
-  write_u16(f, 1); // PCM
+  write_u16(f, fmt.format == SampleFormat::Float32 ? 3 : 1); // IEEE float : PCM
   write_u16(f, (std::uint16_t)channels);
-  write_u32(f, (std::uint32_t)sampleRate);
-  write_u32(f, (std::uint32_t)(sampleRate * channels * (bitsPerSample / 8)));
+  write_u32(f, (std::uint32_t)fmt.sampleRate);
+  write_u32(f, (std::uint32_t)(fmt.sampleRate * channels * (bitsPerSample / 8)));
   write_u16(f, (std::uint16_t)(channels * (bitsPerSample / 8)));
   write_u16(f, (std::uint16_t)bitsPerSample);
 
   f.write("data", 4);
   write_u32(f, dataBytes);
-  f.write(reinterpret_cast<const char*>(pcm.data()), dataBytes);
-  return true;
 }
 
-static inline double clamp1(double x) { return std::max(-1.0, std::min(1.0, x)); }
-static inline double dnoise(double t) {
-  return 0.55*std::sin(2.0*M_PI*937.0*t) + 0.35*std::sin(2.0*M_PI*1433.0*t) + 0.20*std::sin(2.0*M_PI*2117.0*t);
+// Encodes `n` samples in kOscBlock pieces through a stack buffer.
+static void write_samples(std::ofstream& f, SampleFormat format, const double* in, std::size_t n) {
+  for (std::size_t b = 0; b < n; b += kOscBlock) {
+    const std::size_t count = std::min<std::size_t>(kOscBlock, n - b);
+    if (format == SampleFormat::Pcm16) {
+      std::int16_t pcm[kOscBlock];
+      quantize16_block(in + b, pcm, count);
+      f.write(reinterpret_cast<const char*>(pcm), (std::streamsize)(count * sizeof(std::int16_t)));
+    } else if (format == SampleFormat::Pcm24) {
+      std::int32_t wide[kOscBlock];
+      char packed[kOscBlock * 3];
+      quantize24_block(in + b, wide, count);
+      for (std::size_t i = 0; i < count; ++i) {
+        packed[3*i]     = (char)(wide[i] & 0xFF);
+        packed[3*i + 1] = (char)((wide[i] >> 8) & 0xFF);
+        packed[3*i + 2] = (char)((wide[i] >> 16) & 0xFF);
+      }
+      f.write(packed, (std::streamsize)(count * 3));
+    } else {
+      float pcm[kOscBlock];
+      for (std::size_t i = 0; i < count; ++i) pcm[i] = (float)in[b + i];
+      f.write(reinterpret_cast<const char*>(pcm), (std::streamsize)(count * sizeof(float)));
+    }
+  }
 }
 
-bool generate_clockwork_loop(const std::string& path, double seconds, int bpm) {
-  const int sr = 44100;
-  const int total = (int)std::round(seconds * sr);
-  std::vector<std::int16_t> pcm(total);
+static bool valid_format(const WavFormat& fmt) {
+  return fmt.sampleRate > 0 && (fmt.channels == 1 || fmt.channels == 2);
+}
+
+bool write_wav(const std::string& path, const WavFormat& fmt, const std::vector<double>& interleaved) {
+  if (!valid_format(fmt)) return false;
+  std::ofstream f(path, std::ios::binary);
+  if (!f) return false;
+
+  const std::uint32_t dataBytes = (std::uint32_t)(interleaved.size() * fmt.bytesPerSample());
+  write_wav_header(f, fmt, dataBytes);
+  write_samples(f, fmt.format, interleaved.data(), interleaved.size());
+  return (bool)f;
+}
+
+bool WavStreamWriter::open(const std::string& path, const WavFormat& fmt) {
+  close();
+  if (!valid_format(fmt)) return false;
+  f_.open(path, std::ios::binary | std::ios::trunc);
+  if (!f_) return false;
+  fmt_ = fmt;
+  frames_ = 0;
+  write_wav_header(f_, fmt_, 0);
+  return (bool)f_;
+}
+
+bool WavStreamWriter::writeFrames(const double* interleaved, std::size_t frames) {
+  if (!f_.is_open()) return false;
+  write_samples(f_, fmt_.format, interleaved, frames * (std::size_t)fmt_.channels);
+  frames_ += frames;
+  return (bool)f_;
+}
+
+bool WavStreamWriter::close() {
+  if (!f_.is_open()) return false;
+  f_.seekp(0);
+  write_wav_header(f_, fmt_, (std::uint32_t)(frames_ * fmt_.channels * fmt_.bytesPerSample()));
+  const bool ok = (bool)f_;
+  f_.close();
+  return ok;
+}
+
+namespace {
+
+// Graph definitions for the pack. Each mirrors the original per-sample
+// expression term for term (same operands, same evaluation order), so the
+// rendered assets are unchanged.
 
+SynthGraph clockwork_loop_graph(int sampleRate, int bpm) {
   const double beatsPerSec = bpm / 60.0;
   const double tickHz = beatsPerSec;
   const double whirrHz = 130.0;
   const double whirrHz2 = 261.0;
 
-  for (int n=0;n<total;n++) {
-    double t = (double)n / sr;
+  SynthGraph g(sampleRate);
+  const auto am = g.affine(g.sine(2.0), 0.45, 0.55);
+  const auto whirr = g.mul(am, g.mix({{g.sine(whirrHz), 0.65}, {g.sine(whirrHz2), 0.35}}), 0.08);
 
-    double am = 0.55 + 0.45*std::sin(2.0*M_PI*2.0*t);
-    double whirr = 0.08*am*(0.65*std::sin(2.0*M_PI*whirrHz*t) + 0.35*std::sin(2.0*M_PI*whirrHz2*t));
+  const auto env = g.envelope(tickHz, 0.03, 180.0);
+  const auto tick = g.mul(env, g.mix({{g.sine(900.0), 0.7}, {g.sine(1400.0), 0.3}}), 0.33);
 
-    double phase = std::fmod(t * tickHz, 1.0);
-    double env = 0.0;
-    if (phase < 0.03) env = std::exp(-phase * 180.0);
-    double tick = 0.33 * env * (0.7*std::sin(2.0*M_PI*900.0*t) + 0.3*std::sin(2.0*M_PI*1400.0*t));
+  const auto gritEnv = g.envelope(tickHz, 0.10, 22.0);
+  const auto grit = g.mul(gritEnv, g.noise(), 0.04);
 
-    double gritEnv = 0.0;
-    if (phase < 0.10) gritEnv = std::exp(-phase * 22.0);
-    double grit = 0.04 * gritEnv * dnoise(t);
-
-    double s = whirr + tick + grit;
-    s = clamp1(s);
-    pcm[n] = (std::int16_t)std::lround(s * 32767.0);
-  }
-
-  return write_wav_mono16(path, pcm, sr);
+  g.limit(g.mix({{whirr, 1.0}, {tick, 1.0}, {grit, 1.0}}));
+  return g;
 }
 
-bool generate_ratchet_tick(const std::string& path, double seconds, int bpm) {
-  const int sr = 44100;
-  const int total = (int)std::round(seconds * sr);
-  std::vector<std::int16_t> pcm(total);
-
+SynthGraph ratchet_tick_graph(int sampleRate, int bpm) {
   const double beatsPerSec = bpm / 60.0;
   const double tickHz = beatsPerSec;
 
-  for (int n=0;n<total;n++) {
-    double t = (double)n / sr;
+  SynthGraph g(sampleRate);
+  const auto env = g.envelope(tickHz, 0.02, 240.0);
+  const auto click = g.mul(env, g.mix({{g.sine(1800.0), 0.6}, {g.sine(2600.0), 0.4}}), 0.55);
+  const auto snap = g.mul(env, g.noise(), 0.35);
 
-    double phase = std::fmod(t * tickHz, 1.0);
-    double env = 0.0;
-    if (phase < 0.02) env = std::exp(-phase * 240.0);
+  g.limit(g.mix({{click, 0.55}, {snap, 0.45}}));
+  return g;
+}
 
-    double click = 0.55*env*(0.6*std::sin(2.0*M_PI*1800.0*t) + 0.4*std::sin(2.0*M_PI*2600.0*t));
-    double snap  = 0.35*env*dnoise(t);
+SynthGraph gear_whirr_graph(int sampleRate, double hz) {
+  SynthGraph g(sampleRate);
+  const auto wob = g.affine(g.sine(0.7), 0.2, 0.8);
+  const auto f1 = g.affine(wob, hz, 0.0);
+  const auto f2 = g.affine(g.affine(g.sine(0.31), 0.1, 0.9), 2.0*hz, 0.0);
 
-    double s = 0.55*click + 0.45*snap;
-    s = clamp1(s);
-    pcm[n] = (std::int16_t)std::lround(s * 32767.0);
+  const auto tone = g.mix({{g.mix({{g.sine(f1), 0.65}, {g.sine(f2), 0.35}}), 0.18}});
+  g.limit(g.mix({{tone, 1.0}, {g.noise(), 0.03}}));
+  return g;
+}
+
+SynthGraph haunted_drone_graph(int sampleRate) {
+  const double base = 48.0;
+  const double detune = 0.07;
+
+  SynthGraph g(sampleRate);
+  std::vector<SynthNode> partials;
+  std::vector<double> gains;
+  for (int k=0;k<13;k++) {
+    const auto fk = g.affine(g.affine(g.sine(0.03 + 0.004*k), detune, 1.0), base * (k+1), 0.0);
+    partials.push_back(g.sine(fk));
+    gains.push_back(1.0 / (1.0 + 0.35*k));
   }
+  const auto s = g.mix(partials, gains);
 
-  return write_wav_mono16(path, pcm, sr);
+  const auto breath = g.affine(g.sine(0.12), 0.45, 0.55);
+  g.limit(g.mix({{g.mul(breath, s, 0.06), 1.0}, {g.mul(breath, g.noise(), 0.01), 1.0}}));
+  return g;
 }
 
-bool generate_gear_whirr(const std::string& path, double seconds, double hz) {
-  const int sr = 44100;
-  const int total = (int)std::round(seconds * sr);
-  std::vector<std::int16_t> pcm(total);
+SynthGraph zodiac_13_pulse_graph(int sampleRate, int bpm) {
+  const double beatsPerSec = bpm / 60.0;
+  const double stepHz = beatsPerSec;
+  const double carrierBase = 220.0;
 
-  for (int n=0;n<total;n++) {
-    double t = (double)n / sr;
+  const double offsets[13] = {0, 2, 5, 7, 9, 12, 14, 12, 9, 7, 5, 2, 0};
+  std::vector<double> stepFreq(13);
+  for (int k = 0; k < 13; k++) stepFreq[k] = carrierBase * std::pow(2.0, offsets[k]/12.0);
 
-    double wob = 0.8 + 0.2*std::sin(2.0*M_PI*0.7*t);
-    double f1 = hz * wob;
-    double f2 = 2.0*hz * (0.9 + 0.1*std::sin(2.0*M_PI*0.31*t));
+  SynthGraph g(sampleRate);
+  const auto freq = g.stepSeq(stepHz, std::move(stepFreq));
+  const auto env = g.envelope(stepHz, 0.10, 18.0);
 
-    double s = 0.18*(0.65*std::sin(2.0*M_PI*f1*t) + 0.35*std::sin(2.0*M_PI*f2*t));
-    s += 0.03*dnoise(t);
+  const auto s = g.mul(env, g.mix({{g.sine(freq), 0.7}, {g.sine(freq, 2.0), 0.3}}), 0.22);
+  g.limit(g.mix({{s, 1.0}, {g.mul(env, g.noise(), 0.02), 1.0}}));
+  return g;
+}
 
-    s = clamp1(s);
-    pcm[n] = (std::int16_t)std::lround(s * 32767.0);
-  }
+int total_samples(double seconds, int sampleRate) {
+  const int total = (int)std::round(seconds * sampleRate);
+  return total > 0 ? total : 0;
+}
 
-  return write_wav_mono16(path, pcm, sr);
+// Renders frames [n0, n1) into frames[n0*channels ..). n0 must be a multiple
+// of kOscBlock so that every sample sees the same block layout (and therefore
+// the same vector/scalar code path) no matter how the range was split.
+void render_range(const SynthGraph& graph, int channels, int n0, int n1, double* frames) {
+  SynthGraph::Scratch scratch;
+  double block[2 * kOscBlock];
+  const int graphChannels = graph.channels();
+  for (int b = n0; b < n1; b += kOscBlock) {
+    const int count = std::min(kOscBlock, n1 - b);
+    double* out = frames + (std::size_t)b * channels;
+    if (graphChannels == channels) {
+      graph.process(b, count, out, scratch);
+      continue;
+    }
+    graph.process(b, count, block, scratch);
+    for (int i = 0; i < count; i++) {
+      if (channels == 2) {
+        out[2*i] = block[i];
+        out[2*i + 1] = block[i];
+      } else {
+        out[i] = 0.5 * (block[2*i] + block[2*i + 1]);
+      }
+    }
+  }
 }
 
-bool generate_haunted_drone(const std::string& path, double seconds) {
-  const int sr = 44100;
-  const int total = (int)std::round(seconds * sr);
-  std::vector<std::int16_t> pcm(total);
+} // namespace
 
-  const double base = 48.0;
-  const double detune = 0.07;
+SynthGraph sound_graph(const SoundJob& job) {
+  const int sr = job.format.sampleRate;
+  switch (job.kind) {
+    case SoundKind::ClockworkLoop: return clockwork_loop_graph(sr, (int)job.rate);
+    case SoundKind::RatchetTick:   return ratchet_tick_graph(sr, (int)job.rate);
+    case SoundKind::GearWhirr:     return gear_whirr_graph(sr, job.rate);
+    case SoundKind::HauntedDrone:  return haunted_drone_graph(sr);
+    case SoundKind::Zodiac13Pulse: return zodiac_13_pulse_graph(sr, (int)job.rate);
+  }
+  throw std::invalid_argument("unknown sound kind");
+}
 
-  for (int n=0;n<total;n++) {
-    double t = (double)n / sr;
+bool render_graph(const SynthGraph& graph, const std::string& path, double seconds, const WavFormat& fmt) {
+  if (!valid_format(fmt) || graph.sampleRate() != fmt.sampleRate) return false;
+  const int total = total_samples(seconds, fmt.sampleRate);
+  std::vector<double> frames((std::size_t)total * fmt.channels);
+  render_range(graph, fmt.channels, 0, total, frames.data());
+  return write_wav(path, fmt, frames);
+}
 
-    double breath = 0.55 + 0.45*std::sin(2.0*M_PI*0.12*t);
+bool render_sound(const SoundJob& job) {
+  return render_graph(sound_graph(job), job.path, job.seconds, job.format);
+}
 
-    double s = 0.0;
-    for (int k=0;k<13;k++) {
-      double fk = base * (k+1) * (1.0 + detune*std::sin(2.0*M_PI*(0.03 + 0.004*k)*t));
-      double ak = 1.0 / (1.0 + 0.35*k);
-      s += ak * std::sin(2.0*M_PI*fk*t);
+std::vector<bool> render_sound_pack(const std::vector<SoundJob>& jobs, unsigned threads, int chunkSamples) {
+  if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+  chunkSamples = std::max(kOscBlock, (chunkSamples / kOscBlock) * kOscBlock);
+
+  struct JobState {
+    SynthGraph graph;
+    std::vector<double> frames;
+    std::atomic<int> chunksLeft{0};
+    bool ok{false};
+  };
+  struct Chunk {
+    std::size_t job;
+    int n0;
+    int n1;
+  };
+
+  std::vector<JobState> state(jobs.size());
+  std::vector<Chunk> chunks;
+  for (std::size_t j = 0; j < jobs.size(); ++j) {
+    if (!valid_format(jobs[j].format)) continue;
+    state[j].graph = sound_graph(jobs[j]);
+    const int total = total_samples(jobs[j].seconds, jobs[j].format.sampleRate);
+    const int n = std::max(1, (total + chunkSamples - 1) / chunkSamples);
+    state[j].frames.resize((std::size_t)total * jobs[j].format.channels);
+    state[j].chunksLeft.store(n, std::memory_order_relaxed);
+    for (int c = 0; c < n; ++c) {
+      chunks.push_back({j, c * chunkSamples, std::min(total, (c + 1) * chunkSamples)});
     }
-    s *= (0.06 * breath);
-    s += 0.01 * breath * dnoise(t);
-
-    s = clamp1(s);
-    pcm[n] = (std::int16_t)std::lround(s * 32767.0);
   }
 
-  return write_wav_mono16(path, pcm, sr);
-}
-
-bool generate_zodiac_13_pulse(const std::string& path, double seconds, int bpm) {
-  const int sr = 44100;
-  const int total = (int)std::round(seconds * sr);
-  std::vector<std::int16_t> pcm(total);
+  // Workers pull chunks in job order; whoever finishes a job's last chunk
+  // writes its file, so disk I/O overlaps with rendering of later jobs.
+  std::atomic<std::size_t> next{0};
+  auto worker = [&] {
+    for (std::size_t c; (c = next.fetch_add(1, std::memory_order_relaxed)) < chunks.size();) {
+      const Chunk& ch = chunks[c];
+      const SoundJob& job = jobs[ch.job];
+      JobState& st = state[ch.job];
+      render_range(st.graph, job.format.channels, ch.n0, ch.n1, st.frames.data());
+      if (st.chunksLeft.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        st.ok = write_wav(job.path, job.format, st.frames);
+        std::vector<double>().swap(st.frames);
+      }
+    }
+  };
 
-  const double beatsPerSec = bpm / 60.0;
-  const double stepHz = beatsPerSec;
-  const double carrierBase = 220.0;
+  threads = std::min<unsigned>(threads, static_cast<unsigned>(std::max<std::size_t>(1, chunks.size())));
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < threads; ++i) pool.emplace_back(worker);
+  worker();
+  for (auto& th : pool) th.join();
 
-  for (int n=0;n<total;n++) {
-    double t = (double)n / sr;
+  std::vector<bool> ok(jobs.size());
+  for (std::size_t j = 0; j < jobs.size(); ++j) ok[j] = state[j].ok;
+  return ok;
+}
 
-    double stepPhase = std::fmod(t * stepHz, 1.0);
-    int step = (int)std::floor(std::fmod(t * stepHz, 13.0));
+std::vector<SoundJob> default_sound_pack(const std::string& dir, const WavFormat& format) {
+  return {
+    {SoundKind::ClockworkLoop, dir + "/clockwork_loop.wav", 3.0, 120.0, format},
+    {SoundKind::RatchetTick,   dir + "/ratchet_tick.wav",   2.0, 120.0, format},
+    {SoundKind::GearWhirr,     dir + "/gear_whirr.wav",     2.5, 140.0, format},
+    {SoundKind::HauntedDrone,  dir + "/haunted_drone.wav",  5.0, 0.0,   format},
+    {SoundKind::Zodiac13Pulse, dir + "/zodiac_13_pulse.wav", 6.0, 120.0, format},
+  };
+}
 
-    double offsets[13] = {0, 2, 5, 7, 9, 12, 14, 12, 9, 7, 5, 2, 0};
-    double semi = offsets[step];
-    double freq = carrierBase * std::pow(2.0, semi/12.0);
+bool generate_clockwork_loop(const std::string& path, double seconds, int bpm) {
+  return render_sound({SoundKind::ClockworkLoop, path, seconds, (double)bpm});
+}
 
-    double env = 0.0;
-    if (stepPhase < 0.10) env = std::exp(-stepPhase * 18.0);
+bool generate_ratchet_tick(const std::string& path, double seconds, int bpm) {
+  return render_sound({SoundKind::RatchetTick, path, seconds, (double)bpm});
+}
 
-    double s = 0.22 * env * (0.7*std::sin(2.0*M_PI*freq*t) + 0.3*std::sin(2.0*M_PI*(2.0*freq)*t));
-    s += 0.02 * env * dnoise(t);
+bool generate_gear_whirr(const std::string& path, double seconds, double hz) {
+  return render_sound({SoundKind::GearWhirr, path, seconds, hz});
+}
 
-    s = clamp1(s);
-    pcm[n] = (std::int16_t)std::lround(s * 32767.0);
-  }
+bool generate_haunted_drone(const std::string& path, double seconds) {
+  return render_sound({SoundKind::HauntedDrone, path, seconds, 0.0});
+}
 
-  return write_wav_mono16(path, pcm, sr);
+bool generate_zodiac_13_pulse(const std::string& path, double seconds, int bpm) {
+  return render_sound({SoundKind::Zodiac13Pulse, path, seconds, (double)bpm});
 }
 
 } // namespace wa::audio
@@ -150,10 +150,16 @@ void GearCPUCore::step() {
   if (halted_) return;
   if (ip_ >= program_.size()) {
     halted_ = true;
+    if (sound_) sound_.emit(clock_.ticks(), SoundEventKind::Halt);
     return;
   }
 
   const GearInstr& ins = program_[ip_];
+  if (sound_) {
+    if (ins.op == GearOp::HALT) sound_.emit(clock_.ticks(), SoundEventKind::Halt);
+    else                        sound_.emit(clock_.ticks(), SoundEventKind::Instr, static_cast<u8>(ins.op));
+  }
+
   switch (ins.op) {
     case GearOp::NOP:
       break;
@@ -1,5 +1,6 @@
 #include "wolfman_alpha/wa_cpu.hpp"
 #include <sstream>
+#include <stdexcept>
 
 namespace wa {
 
@@ -16,12 +17,19 @@ CpuBase::CpuBase(Machine& m, CpuConfig cfg) : m_(m), cfg_(cfg) {
 
 void CpuBase::step() {
   if (halted_) return;
-  if (ip_ >= prog_.size()) { halted_ = true; return; }
+  if (ip_ >= prog_.size()) {
+    halted_ = true;
+    if (sound_) sound_.emit(m_.ticks(), SoundEventKind::Halt);
+    return;
+  }
 
   // Zodiac hook example: glyph Z12 causes an extra tick before executing
   if (cfg_.useZodiac && m_.ringCount() > 0) {
     auto g = activeGlyphFromOffset(m_.ring(0).offset(), m_.gearsPerRing());
-    if (g == Zodiac13::Z12) m_.tickAll(1);
+    if (g == Zodiac13::Z12) {
+      m_.tickAll(1);
+      if (sound_) sound_.emit(m_.ticks(), SoundEventKind::Zodiac, (u8)g);
+    }
   }
 
   exec(prog_[ip_]);
@@ -29,9 +37,17 @@ void CpuBase::step() {
 
   // mechanical clock tick
   m_.tickAll(1);
+  cycles_++;
 }
 
 void CpuBase::exec(const Instr& ins) {
+  if (sound_) {
+    if (ins.op == Op::SHIFT_RING)    sound_.emit(m_.ticks(), SoundEventKind::RingShift, (u8)ins.imm);
+    else if (ins.op == Op::TICK_ALL) sound_.emit(m_.ticks(), SoundEventKind::RingShift, 0xFF);
+    else if (ins.op == Op::HALT)     sound_.emit(m_.ticks(), SoundEventKind::Halt);
+    else                             sound_.emit(m_.ticks(), SoundEventKind::Instr, (u8)ins.op);
+  }
+
   switch (ins.op) {
     case Op::NOP: break;
 
@@ -69,4 +85,11 @@ CPU64::CPU64(Machine& m)  : CpuBase(m, CpuConfig{WordSize::W64,  8, true, true})
 CPU360::CPU360(Machine& m): CpuBase(m, CpuConfig{WordSize::W360, 8, true, true}) {}
 CPU720::CPU720(Machine& m): CpuBase(m, CpuConfig{WordSize::W720, 8, true, true}) {}
 
+std::unique_ptr<CpuBase> make_cpu(int wordBits, Machine& m) {
+  if (wordBits == 64) return std::make_unique<CPU64>(m);
+  if (wordBits == 360) return std::make_unique<CPU360>(m);
+  if (wordBits == 720) return std::make_unique<CPU720>(m);
+  throw std::invalid_argument("mode must be 64, 360, or 720");
+}
+
 } // namespace wa
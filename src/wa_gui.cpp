@@ -1,4 +1,8 @@
 #include "wolfman_alpha/wa_gui.hpp"
+#include "wolfman_alpha/wa_math.hpp"
+#include <algorithm>
+#include <map>
+#include <mutex>
 #include <sstream>
 
 namespace wa::gui {
@@ -6,6 +10,49 @@ namespace wa::gui {
 Widget::Widget(WidgetId id, WidgetKind kind, std::string text, Rect bounds)
   : id_(id), kind_(kind), text_(std::move(text)), bounds_(bounds) {}
 
+void Widget::touch() {
+  version_++;
+  if (!host_) return;
+  if (visible_) host_->damage.add(bounds_);
+  if (!dirty_) host_->dirty.push_back(id_);
+  dirty_ = true;
+}
+
+void Widget::setText(std::string value) {
+  if (value == text_) return;
+  text_ = std::move(value);
+  touch();
+}
+
+void Widget::setBounds(Rect r) {
+  const Rect old = bounds_;
+  if (old.x == r.x && old.y == r.y && old.w == r.w && old.h == r.h) return;
+  touch(); // damages the old area
+  bounds_ = r;
+  if (host_ && visible_) {
+    host_->grid.erase(id_, old);
+    host_->grid.insert(id_, z_, r);
+    host_->damage.add(r);
+  }
+}
+
+void Widget::setVisible(bool v) {
+  if (v == visible_) return;
+  if (host_) {
+    if (v) host_->grid.insert(id_, z_, bounds_);
+    else   host_->grid.erase(id_, bounds_);
+    host_->damage.add(bounds_);
+  }
+  visible_ = v;
+  touch();
+}
+
+void Widget::setEnabled(bool e) {
+  if (e == enabled_) return;
+  enabled_ = e;
+  touch();
+}
+
 bool Widget::handleEvent(const Event&) {
   return false;
 }
@@ -25,7 +72,7 @@ InputWidget::InputWidget(WidgetId id, std::string text, Rect bounds)
 bool InputWidget::handleEvent(const Event& ev) {
   if (!enabled() || !visible()) return false;
   if (ev.type == EventType::TextInput && ev.target == id()) {
-    setText(text() + ev.text);
+    if (!ev.text.empty()) setText(text() + ev.text);
     return true;
   }
   return false;
@@ -37,57 +84,371 @@ SwitchWidget::SwitchWidget(WidgetId id, std::string text, Rect bounds, bool init
 bool SwitchWidget::handleEvent(const Event& ev) {
   if (!enabled() || !visible()) return false;
   if (ev.type == EventType::Click && ev.target == id()) {
-    on_ = !on_;
+    setOn(!on_);
     return true;
   }
   return false;
 }
 
-GuiWindow::GuiWindow(std::string title, Rect bounds) : title_(std::move(title)), bounds_(bounds) {}
+void SwitchWidget::setOn(bool value) {
+  if (value == on_) return;
+  on_ = value;
+  touch();
+}
 
-WidgetId GuiWindow::addLabel(const std::string& text, Rect bounds) {
-  const WidgetId id = nextId_++;
-  widgets_.emplace(id, std::make_unique<Widget>(id, WidgetKind::Label, text, bounds));
+void EventQueue::push(const Event& ev) {
+  const bool mergeable = ev.type == EventType::MouseMove || ev.type == EventType::ValueChanged;
+  if (mergeable) {
+    for (std::size_t i = burstStart_; i < size_; ++i) {
+      if (buf_[i].type == ev.type && buf_[i].target == ev.target) {
+        buf_[i] = ev;
+        coalesced_++;
+        return;
+      }
+    }
+  }
+  if (size_ < buf_.size()) buf_[size_] = ev;
+  else buf_.push_back(ev);
+  size_++;
+  if (!mergeable) burstStart_ = size_;
+}
+
+void WidgetGrid::reset(Rect area) {
+  area_ = area;
+  cols_ = area.w > 0 ? (area.w + kCellSize - 1) / kCellSize : 0;
+  rows_ = area.h > 0 ? (area.h + kCellSize - 1) / kCellSize : 0;
+  cells_.assign((std::size_t)cols_ * (std::size_t)rows_, {});
+}
+
+// Cells overlapped by r, clipped to the grid; false if none.
+bool WidgetGrid::cellSpan(Rect r, int& c0, int& r0, int& c1, int& r1) const {
+  if (r.w <= 0 || r.h <= 0 || cols_ == 0 || rows_ == 0) return false;
+  const int x0 = std::max(r.x, area_.x) - area_.x;
+  const int y0 = std::max(r.y, area_.y) - area_.y;
+  const int x1 = std::min(r.x + r.w, area_.x + area_.w) - area_.x - 1;
+  const int y1 = std::min(r.y + r.h, area_.y + area_.h) - area_.y - 1;
+  if (x1 < x0 || y1 < y0) return false;
+  c0 = x0 / kCellSize;
+  r0 = y0 / kCellSize;
+  c1 = x1 / kCellSize;
+  r1 = y1 / kCellSize;
+  return true;
+}
+
+void WidgetGrid::insert(WidgetId id, std::uint64_t z, Rect r) {
+  int c0, r0, c1, r1;
+  if (!cellSpan(r, c0, r0, c1, r1)) return;
+  for (int row = r0; row <= r1; ++row) {
+    for (int col = c0; col <= c1; ++col) cells_[(std::size_t)row * cols_ + col].push_back({id, z, r});
+  }
+}
+
+void WidgetGrid::erase(WidgetId id, Rect r) {
+  int c0, r0, c1, r1;
+  if (!cellSpan(r, c0, r0, c1, r1)) return;
+  for (int row = r0; row <= r1; ++row) {
+    for (int col = c0; col <= c1; ++col) {
+      auto& cell = cells_[(std::size_t)row * cols_ + col];
+      for (std::size_t i = 0; i < cell.size(); ++i) {
+        if (cell[i].id == id) {
+          cell[i] = cell.back();
+          cell.pop_back();
+          break;
+        }
+      }
+    }
+  }
+}
+
+WidgetId WidgetGrid::hit(int x, int y) const {
+  if (!area_.contains(x, y) || cols_ == 0 || rows_ == 0) return 0;
+  const auto& cell = cells_[(std::size_t)((y - area_.y) / kCellSize) * cols_ + (x - area_.x) / kCellSize];
+  WidgetId best = 0;
+  std::uint64_t bestZ = 0;
+  for (const auto& e : cell) {
+    if (e.z > bestZ && e.r.contains(x, y)) {
+      best = e.id;
+      bestZ = e.z;
+    }
+  }
+  return best;
+}
+
+void WidgetGrid::query(Rect r, std::vector<WidgetId>& out) const {
+  int c0, r0, c1, r1;
+  if (!cellSpan(r, c0, r0, c1, r1)) return;
+  for (int row = r0; row <= r1; ++row) {
+    for (int col = c0; col <= c1; ++col) {
+      for (const auto& e : cells_[(std::size_t)row * cols_ + col]) {
+        const int x0 = std::max(e.r.x, r.x), y0 = std::max(e.r.y, r.y);
+        if (x0 >= std::min(e.r.x + e.r.w, r.x + r.w) || y0 >= std::min(e.r.y + e.r.h, r.y + r.h)) continue;
+        // Report a widget only from the cell holding the top-left corner of
+        // its overlap with r, so widgets spanning several cells appear once.
+        const int oc = (std::max(x0, area_.x) - area_.x) / kCellSize;
+        const int orow = (std::max(y0, area_.y) - area_.y) / kCellSize;
+        if (oc == col && orow == row) out.push_back(e.id);
+      }
+    }
+  }
+}
+
+void DamageList::add(Rect r) {
+  const int x0 = std::max(r.x, clip_.x);
+  const int y0 = std::max(r.y, clip_.y);
+  const int x1 = std::min(r.x + r.w, clip_.x + clip_.w);
+  const int y1 = std::min(r.y + r.h, clip_.y + clip_.h);
+  if (x1 <= x0 || y1 <= y0) return;
+  r = {x0, y0, x1 - x0, y1 - y0};
+
+  for (const Rect& d : rects_) {
+    if (r.x >= d.x && r.y >= d.y && r.x + r.w <= d.x + d.w && r.y + r.h <= d.y + d.h) return;
+  }
+  if (rects_.size() < kMaxRects) {
+    rects_.push_back(r);
+    return;
+  }
+  Rect u = r;
+  for (const Rect& d : rects_) {
+    const int ux1 = std::max(u.x + u.w, d.x + d.w);
+    const int uy1 = std::max(u.y + u.h, d.y + d.h);
+    u.x = std::min(u.x, d.x);
+    u.y = std::min(u.y, d.y);
+    u.w = ux1 - u.x;
+    u.h = uy1 - u.y;
+  }
+  rects_.assign(1, u);
+}
+
+const RingLut& RingLut::get(int gearCount, int radius) {
+  static std::mutex mu;
+  static std::map<std::pair<int, int>, std::unique_ptr<RingLut>> cache;
+  std::lock_guard<std::mutex> lock(mu);
+  auto& slot = cache[{gearCount, radius}];
+  if (!slot) {
+    slot = std::make_unique<RingLut>();
+    slot->gearCount = gearCount;
+    slot->radius = radius;
+    slot->dx.resize((std::size_t)std::max(0, gearCount));
+    slot->dy.resize((std::size_t)std::max(0, gearCount));
+    for (int i = 0; i < gearCount; ++i) {
+      // Gear 0 at 12 o'clock, increasing clockwise on screen (y down).
+      const auto p = math::polar(radius, math::ring_index_to_angle_rad(i, gearCount) - math::PI / 2.0);
+      slot->dx[i] = (std::int16_t)std::lround(p.x);
+      slot->dy[i] = (std::int16_t)std::lround(p.y);
+    }
+    for (int g = 0; g < ZODIAC_COUNT; ++g) {
+      int first = 0, last = 0;
+      glyphIndexRange((Zodiac13)g, gearCount, first, last);
+      slot->glyphFirst[g] = first;
+    }
+  }
+  return *slot;
+}
+
+RingWidget::RingWidget(WidgetId id, std::string text, Rect bounds, const Ring* ring)
+  : Widget(id, WidgetKind::Ring, std::move(text), bounds), ring_(ring) {
+  refresh();
+}
+
+int RingWidget::radius() const {
+  // Leave room for the 2 px gear dots and the offset marker.
+  return std::max(0, std::min(bounds().w, bounds().h) / 2 - 6);
+}
+
+bool RingWidget::refresh() {
+  if (!ring_) return false;
+  const int n = ring_->gearCount();
+  bool changed = (int)bits_.size() != n || offset_ != ring_->offset();
+  bits_.resize((std::size_t)n);
+  // Logical 0 sits at physical `offset`; walk the runs to fill physical order.
+  int phys = ring_->offset();
+  ring_->forEachRun(n, [&](const Gear* g, int len) {
+    for (int i = 0; i < len; ++i, ++phys) {
+      if (phys == n) phys = 0;
+      const u8 b = g[i].bit & 1u;
+      if (bits_[phys] != b) {
+        bits_[phys] = b;
+        changed = true;
+      }
+    }
+  });
+  offset_ = ring_->offset();
+  if (changed) touch();
+  return changed;
+}
+
+GuiWindow::GuiWindow(std::string title, Rect bounds)
+  : title_(std::move(title)), bounds_(bounds), host_(std::make_unique<WidgetHost>()) {
+  host_->grid.reset(bounds_);
+  host_->damage.setClip(bounds_);
+  host_->damage.addAll();
+}
+
+void GuiWindow::setTitle(std::string title) {
+  if (title == title_) return;
+  title_ = std::move(title);
+  invalidate();
+}
+
+void GuiWindow::setBounds(Rect r) {
+  bounds_ = r;
+  host_->grid.reset(bounds_);
+  forEachWidget([&](const Widget& w) {
+    if (w.visible()) host_->grid.insert(w.id(), w.z_, w.bounds());
+  });
+  host_->damage.clear();
+  host_->damage.setClip(bounds_);
+  invalidate();
+}
+
+void GuiWindow::frameDrawn() {
+  for (WidgetId id : host_->dirty) {
+    if (Widget* w = find(id)) w->dirty_ = false;
+  }
+  host_->dirty.clear();
+  host_->damage.clear();
+}
+
+template <class T, class... Args>
+WidgetId GuiWindow::add(std::vector<T>& dense, WidgetKind kind, Args&&... args) {
+  std::uint32_t slotIndex;
+  if (!freeSlots_.empty()) {
+    slotIndex = freeSlots_.back();
+    freeSlots_.pop_back();
+  } else {
+    slotIndex = (std::uint32_t)slots_.size();
+    slots_.emplace_back();
+  }
+  Slot& slot = slots_[slotIndex];
+  slot.index = (std::uint32_t)dense.size();
+  slot.kind = kind;
+  slot.live = true;
+  const WidgetId id = ((WidgetId)slot.generation << 32) | slotIndex;
+  T& w = dense.emplace_back(id, std::forward<Args>(args)...);
+  w.host_ = host_.get();
+  w.z_ = nextZ_++;
+  host_->grid.insert(id, w.z_, w.bounds());
+  w.touch();
   return id;
 }
 
+WidgetId GuiWindow::addLabel(const std::string& text, Rect bounds) {
+  return add(labels_, WidgetKind::Label, WidgetKind::Label, text, bounds);
+}
+
 WidgetId GuiWindow::addButton(const std::string& text, Rect bounds) {
-  const WidgetId id = nextId_++;
-  widgets_.emplace(id, std::make_unique<ButtonWidget>(id, text, bounds));
-  return id;
+  return add(buttons_, WidgetKind::Button, text, bounds);
 }
 
 WidgetId GuiWindow::addInput(const std::string& text, Rect bounds) {
-  const WidgetId id = nextId_++;
-  widgets_.emplace(id, std::make_unique<InputWidget>(id, text, bounds));
-  return id;
+  return add(inputs_, WidgetKind::Input, text, bounds);
 }
 
 WidgetId GuiWindow::addSwitch(const std::string& text, Rect bounds, bool initialOn) {
-  const WidgetId id = nextId_++;
-  widgets_.emplace(id, std::make_unique<SwitchWidget>(id, text, bounds, initialOn));
-  return id;
+  return add(switches_, WidgetKind::Switch, text, bounds, initialOn);
+}
+
+WidgetId GuiWindow::addRing(const std::string& text, Rect bounds, const Ring& ring) {
+  return add(rings_, WidgetKind::Ring, text, bounds, &ring);
+}
+
+int GuiWindow::refreshRings() {
+  int changed = 0;
+  for (auto& w : rings_) changed += w.refresh() ? 1 : 0;
+  return changed;
+}
+
+// Swap-and-pop, then repoint the slot of the widget that moved.
+template <class T>
+void GuiWindow::eraseDense(std::vector<T>& dense, std::uint32_t index) {
+  if (index + 1 != dense.size()) {
+    dense[index] = std::move(dense.back());
+    slots_[(std::uint32_t)dense[index].id()].index = index;
+  }
+  dense.pop_back();
+}
+
+bool GuiWindow::remove(WidgetId id) {
+  const Slot* found = slotOf(id);
+  if (!found) return false;
+  const auto slotIndex = (std::uint32_t)id;
+  Slot& slot = slots_[slotIndex];
+  if (const Widget* w = widgetAt(slot); w->visible()) {
+    host_->grid.erase(id, w->bounds());
+    host_->damage.add(w->bounds());
+  }
+  switch (slot.kind) {
+    case WidgetKind::Button: eraseDense(buttons_, slot.index); break;
+    case WidgetKind::Input:  eraseDense(inputs_, slot.index); break;
+    case WidgetKind::Switch: eraseDense(switches_, slot.index); break;
+    case WidgetKind::Ring:   eraseDense(rings_, slot.index); break;
+    default:                 eraseDense(labels_, slot.index); break;
+  }
+  slot.live = false;
+  if (++slot.generation == 0) slot.generation = 1;
+  freeSlots_.push_back(slotIndex);
+  return true;
+}
+
+const GuiWindow::Slot* GuiWindow::slotOf(WidgetId id) const {
+  const auto slotIndex = (std::uint32_t)id;
+  if (slotIndex >= slots_.size()) return nullptr;
+  const Slot& slot = slots_[slotIndex];
+  if (!slot.live || slot.generation != (std::uint32_t)(id >> 32)) return nullptr;
+  return &slot;
+}
+
+Widget* GuiWindow::widgetAt(const Slot& slot) {
+  switch (slot.kind) {
+    case WidgetKind::Button: return &buttons_[slot.index];
+    case WidgetKind::Input:  return &inputs_[slot.index];
+    case WidgetKind::Switch: return &switches_[slot.index];
+    case WidgetKind::Ring:   return &rings_[slot.index];
+    default:                 return &labels_[slot.index];
+  }
 }
 
 Widget* GuiWindow::find(WidgetId id) {
-  auto it = widgets_.find(id);
-  if (it == widgets_.end()) return nullptr;
-  return it->second.get();
+  const Slot* slot = slotOf(id);
+  return slot ? widgetAt(*slot) : nullptr;
 }
 
 const Widget* GuiWindow::find(WidgetId id) const {
-  auto it = widgets_.find(id);
-  if (it == widgets_.end()) return nullptr;
-  return it->second.get();
+  return const_cast<GuiWindow*>(this)->find(id);
 }
 
 std::vector<WidgetId> GuiWindow::widgetIds() const {
   std::vector<WidgetId> ids;
-  ids.reserve(widgets_.size());
-  for (const auto& kv : widgets_) ids.push_back(kv.first);
+  ids.reserve(widgetCount());
+  forEachWidget([&](const Widget& w) { ids.push_back(w.id()); });
   return ids;
 }
 
+void GuiWindow::resolveTarget(Event& ev) const {
+  if (ev.target != 0) return;
+  switch (ev.type) {
+    case EventType::MouseDown:
+    case EventType::MouseUp:
+    case EventType::MouseMove:
+    case EventType::Click:
+      ev.target = hitTest(ev.mouseX, ev.mouseY);
+      break;
+    default:
+      break;
+  }
+}
+
+void GuiWindow::widgetsIn(Rect r, std::vector<const Widget*>& out) const {
+  out.clear();
+  auto& ids = host_->queryIds;
+  ids.clear();
+  host_->grid.query(r, ids);
+  for (WidgetId id : ids) {
+    if (const Widget* w = find(id)) out.push_back(w);
+  }
+  std::sort(out.begin(), out.end(), [](const Widget* a, const Widget* b) { return a->z() < b->z(); });
+}
+
 bool GuiWindow::dispatch(const Event& ev) {
   if (Widget* w = find(ev.target)) return w->handleEvent(ev);
   return false;
@@ -103,21 +464,21 @@ void MockBackend::shutdown() {
   ready_ = false;
 }
 
-std::vector<Event> MockBackend::pollEvents() {
-  std::vector<Event> out;
-  out.swap(pending_);
-  return out;
+void MockBackend::pollEvents(EventQueue& out) {
+  for (const Event& ev : pending_) out.push(ev);
+  pending_.clear();
 }
 
 void MockBackend::draw(const GuiWindow& window) {
   if (!ready_) return;
   std::ostringstream oss;
-  oss << "draw window \"" << window.title() << "\" widgets=" << window.widgetIds().size();
+  oss << "draw window \"" << window.title() << "\" widgets=" << window.widgetCount()
+      << " dirty=" << window.dirtyWidgets().size() << " damage=" << window.damageRects().size();
   frameLog_.push_back(oss.str());
 }
 
 void MockBackend::queueEvent(const Event& ev) {
-  pending_.push_back(ev);
+  pending_.push(ev);
 }
 
 GuiApp::GuiApp(std::unique_ptr<GuiBackend> backend, GuiWindow window)
@@ -134,14 +495,30 @@ void GuiApp::stop() {
   running_ = false;
 }
 
+void GuiApp::onEvent(EventHook hook) {
+  subscribe([hook = std::move(hook)](const EventQueue& batch) {
+    for (const Event& ev : batch) hook(ev);
+  });
+}
+
 void GuiApp::runFrame() {
   if (!running_ || !backend_) return;
-  const auto events = backend_->pollEvents();
-  for (const auto& ev : events) {
+  events_.clear();
+  backend_->pollEvents(events_);
+  for (Event& ev : events_) {
+    window_.resolveTarget(ev);
     window_.dispatch(ev);
-    if (hook_) hook_(ev);
+  }
+  if (!events_.empty()) {
+    for (const auto& hook : hooks_) hook(events_);
+  }
+  if (!window_.needsRedraw()) {
+    framesSkipped_++;
+    return;
   }
   backend_->draw(window_);
+  window_.frameDrawn();
+  framesDrawn_++;
 }
 
 } // namespace wa::gui
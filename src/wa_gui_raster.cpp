@@ -0,0 +1,238 @@
+#include "wolfman_alpha/wa_gui_raster.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+namespace wa::gui {
+
+namespace {
+
+constexpr Rgba kBackground = rgba(24, 22, 28);
+constexpr Rgba kText = rgba(226, 218, 196);
+constexpr Rgba kTextDark = rgba(30, 28, 34);
+constexpr Rgba kButton = rgba(92, 70, 46);
+constexpr Rgba kBorder = rgba(176, 140, 82);
+constexpr Rgba kInput = rgba(236, 232, 220);
+constexpr Rgba kSwitchOff = rgba(70, 70, 78);
+constexpr Rgba kSwitchOn = rgba(70, 150, 90);
+constexpr Rgba kKnob = rgba(220, 220, 220);
+constexpr Rgba kDisabled = rgba(60, 60, 64);
+constexpr Rgba kBitOn = rgba(240, 196, 96);
+constexpr Rgba kBitOff = rgba(64, 58, 52);
+constexpr Rgba kGlyphOff = rgba(96, 84, 120);
+constexpr Rgba kHead = rgba(220, 70, 60);
+
+Rect intersect(Rect a, Rect b) {
+  const int x0 = std::max(a.x, b.x);
+  const int y0 = std::max(a.y, b.y);
+  const int x1 = std::min(a.x + a.w, b.x + b.w);
+  const int y1 = std::min(a.y + a.h, b.y + b.h);
+  if (x1 <= x0 || y1 <= y0) return {};
+  return {x0, y0, x1 - x0, y1 - y0};
+}
+
+bool empty(Rect r) { return r.w <= 0 || r.h <= 0; }
+
+} // namespace
+
+void Framebuffer::resize(int width, int height) {
+  width_ = std::max(0, width);
+  height_ = std::max(0, height);
+  pixels_.assign((std::size_t)width_ * (std::size_t)height_, 0);
+}
+
+bool Framebuffer::clip(Rect& r) const {
+  r = intersect(r, {0, 0, width_, height_});
+  return !empty(r);
+}
+
+void Framebuffer::fill(Rect r, Rgba color) {
+  if (!clip(r)) return;
+  Rgba* row = pixels_.data() + (std::size_t)r.y * width_ + r.x;
+  for (int y = 0; y < r.h; ++y, row += width_) std::fill_n(row, r.w, color);
+}
+
+void Framebuffer::frame(Rect r, Rgba color) {
+  if (empty(r)) return;
+  fill({r.x, r.y, r.w, 1}, color);
+  fill({r.x, r.y + r.h - 1, r.w, 1}, color);
+  fill({r.x, r.y, 1, r.h}, color);
+  fill({r.x + r.w - 1, r.y, 1, r.h}, color);
+}
+
+void Framebuffer::blit(const Framebuffer& src, Rect srcRect, int dx, int dy) {
+  srcRect = intersect(srcRect, {0, 0, src.width_, src.height_});
+  // Clip the destination, then shift the source origin by the same amount.
+  Rect dst = intersect({dx, dy, srcRect.w, srcRect.h}, {0, 0, width_, height_});
+  if (empty(dst)) return;
+  const int sx = srcRect.x + (dst.x - dx);
+  const int sy = srcRect.y + (dst.y - dy);
+  for (int y = 0; y < dst.h; ++y) {
+    std::memcpy(pixels_.data() + (std::size_t)(dst.y + y) * width_ + dst.x,
+                src.pixels_.data() + (std::size_t)(sy + y) * src.width_ + sx,
+                (std::size_t)dst.w * sizeof(Rgba));
+  }
+}
+
+bool Framebuffer::writePpm(const std::string& path) const {
+  std::ofstream f(path, std::ios::binary | std::ios::trunc);
+  if (!f) return false;
+  f << "P6\n" << width_ << " " << height_ << "\n255\n";
+  std::vector<char> row((std::size_t)width_ * 3);
+  for (int y = 0; y < height_; ++y) {
+    const Rgba* px = pixels_.data() + (std::size_t)y * width_;
+    for (int x = 0; x < width_; ++x) {
+      row[(std::size_t)x * 3 + 0] = (char)(px[x] & 0xFF);
+      row[(std::size_t)x * 3 + 1] = (char)((px[x] >> 8) & 0xFF);
+      row[(std::size_t)x * 3 + 2] = (char)((px[x] >> 16) & 0xFF);
+    }
+    f.write(row.data(), (std::streamsize)row.size());
+  }
+  return (bool)f;
+}
+
+bool RasterBackend::init() {
+  ready_ = true;
+  frames_ = 0;
+  pixelsPainted_ = 0;
+  totalFrameSeconds_ = 0.0;
+  return true;
+}
+
+void RasterBackend::shutdown() {
+  ready_ = false;
+}
+
+void RasterBackend::pollEvents(EventQueue& out) {
+  for (const Event& ev : pending_) out.push(ev);
+  pending_.clear();
+}
+
+void RasterBackend::queueEvent(const Event& ev) {
+  pending_.push(ev);
+}
+
+void RasterBackend::draw(const GuiWindow& window) {
+  if (!ready_) return;
+  const auto t0 = std::chrono::steady_clock::now();
+  const Rect wb = window.bounds();
+  if (fb_.width() != wb.w || fb_.height() != wb.h) {
+    fb_.resize(wb.w, wb.h);
+    paintRect(window, wb);
+  } else {
+    for (const Rect& d : window.damageRects()) paintRect(window, d);
+  }
+  lastFrameSeconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  totalFrameSeconds_ += lastFrameSeconds_;
+  frames_++;
+  if (!dumpPath_.empty()) {
+    fb_.writePpm(dumpPath_);
+    dumpPath_.clear();
+  }
+}
+
+// Repaints one damaged window-space rect: background, then every visible
+// widget overlapping it, bottom to top. Candidates come from the window's
+// widget grid, so the cost follows the rect, not the widget count.
+void RasterBackend::paintRect(const GuiWindow& window, Rect damage) {
+  const Rect wb = window.bounds();
+  damage = intersect(damage, wb);
+  if (empty(damage)) return;
+
+  window.widgetsIn(damage, visible_);
+
+  // Framebuffer pixel (0, 0) is the window origin.
+  const Rect local{damage.x - wb.x, damage.y - wb.y, damage.w, damage.h};
+  fb_.fill(local, kBackground);
+  for (const Widget* w : visible_) paintWidget(*w, local, wb.x, wb.y);
+  pixelsPainted_ += (std::uint64_t)damage.w * (std::uint64_t)damage.h;
+}
+
+void RasterBackend::paintWidget(const Widget& w, Rect clip, int originX, int originY) {
+  // Framebuffer coordinates; every fill is clipped to the damage.
+  const Rect wb{w.bounds().x - originX, w.bounds().y - originY, w.bounds().w, w.bounds().h};
+  clip = intersect(clip, wb); // nothing paints outside the widget's own bounds
+  auto fillClipped = [&](Rect r, Rgba c) {
+    Rect v = intersect(r, clip);
+    if (!empty(v)) fb_.fill(v, c);
+  };
+  auto frameClipped = [&](Rect r, Rgba c) {
+    fillClipped({r.x, r.y, r.w, 1}, c);
+    fillClipped({r.x, r.y + r.h - 1, r.w, 1}, c);
+    fillClipped({r.x, r.y, 1, r.h}, c);
+    fillClipped({r.x + r.w - 1, r.y, 1, r.h}, c);
+  };
+  // Greeked text: a 5x7 cell per non-space character, clipped to the widget.
+  auto text = [&](int x, int y, Rgba c) {
+    const int right = wb.x + wb.w - 2;
+    for (char ch : w.text()) {
+      if (x + 5 > right) break;
+      if (ch != ' ') fillClipped({x, y, 5, 7}, c);
+      x += 6;
+    }
+  };
+
+  const int ty = wb.y + (wb.h - 7) / 2;
+  const bool on = w.enabled();
+  switch (w.kind()) {
+    case WidgetKind::Button:
+      fillClipped(wb, on ? kButton : kDisabled);
+      frameClipped(wb, kBorder);
+      text(wb.x + 8, ty, kText);
+      break;
+    case WidgetKind::Input:
+      fillClipped(wb, on ? kInput : kDisabled);
+      frameClipped(wb, kBorder);
+      text(wb.x + 6, ty, kTextDark);
+      break;
+    case WidgetKind::Switch: {
+      const bool state = static_cast<const SwitchWidget&>(w).on();
+      const Rect track{wb.x + 2, wb.y + (wb.h - 16) / 2, 36, 16};
+      fillClipped(track, !on ? kDisabled : state ? kSwitchOn : kSwitchOff);
+      fillClipped({state ? track.x + 20 : track.x + 2, track.y + 2, 14, 12}, kKnob);
+      text(wb.x + 46, ty, kText);
+      break;
+    }
+    case WidgetKind::Ring:
+      paintRing(static_cast<const RingWidget&>(w), wb, clip);
+      text(wb.x + 4, wb.y + 4, kText);
+      break;
+    case WidgetKind::Panel:
+      fillClipped(wb, kSwitchOff);
+      frameClipped(wb, kBorder);
+      break;
+    default:
+      text(wb.x + 4, ty, on ? kText : kDisabled);
+      break;
+  }
+}
+
+// One 2x2 dot per gear from the shared polar LUT; the active glyph's sector
+// is tinted and the read position (physical index `offset`) gets a marker.
+void RasterBackend::paintRing(const RingWidget& w, Rect wb, Rect clip) {
+  const auto& bits = w.bits();
+  const int n = (int)bits.size();
+  if (n == 0) return;
+  const RingLut& lut = RingLut::get(n, w.radius());
+  const int cx = wb.x + wb.w / 2 - 1;
+  const int cy = wb.y + wb.h / 2 - 1;
+
+  int first = 0, last = -1;
+  glyphIndexRange(w.glyph(), n, first, last);
+  const bool whole = clip.x <= wb.x && clip.y <= wb.y && clip.x + clip.w >= wb.x + wb.w && clip.y + clip.h >= wb.y + wb.h;
+  for (int i = 0; i < n; ++i) {
+    const Rgba c = bits[i] ? kBitOn : (i >= first && i <= last) ? kGlyphOff : kBitOff;
+    const Rect dot{cx + lut.dx[i], cy + lut.dy[i], 2, 2};
+    if (whole) {
+      fb_.fill(dot, c); // common case: the whole widget is damaged
+    } else {
+      const Rect v = intersect(dot, clip);
+      if (!empty(v)) fb_.fill(v, c);
+    }
+  }
+  const Rect head = intersect({cx + lut.dx[w.offset()] - 1, cy + lut.dy[w.offset()] - 1, 4, 4}, clip);
+  if (!empty(head)) fb_.fill(head, kHead);
+}
+
+} // namespace wa::gui
@@ -1,5 +1,7 @@
 #include "wolfman_alpha/wa_io.hpp"
 #include "wolfman_alpha/wa_calc.hpp"
+#include "wolfman_alpha/wa_json.hpp"
+#include "wolfman_alpha/wa_math.hpp"
 #include <iostream>
 #include <sstream>
 #include <algorithm>
@@ -7,12 +9,13 @@
 #include <iomanip>
 #include <chrono>
 #include <ctime>
+#include <cstdlib>
+#include <cctype>
+#include <functional>
 
 namespace wa {
 
-namespace {
-
-enum class CommandId {
+enum class Console::CommandId : u8 {
   Help,
   Quit,
   Mode,
@@ -31,10 +34,15 @@ enum class CommandId {
   Windows,
   Calc,
   Equation,
+  Sonify,
+  Journal,
+  Replay,
+  Format,
+  Repeat,
   Unknown
 };
 
-CommandId parseCommandId(const std::string& op) {
+Console::CommandId Console::parseCommandId(const std::string& op) {
   static const std::unordered_map<std::string, CommandId> kMap{
     {"help", CommandId::Help},
     {"quit", CommandId::Quit},
@@ -55,6 +63,11 @@ CommandId parseCommandId(const std::string& op) {
     {"windows", CommandId::Windows},
     {"calc", CommandId::Calc},
     {"equation", CommandId::Equation},
+    {"sonify", CommandId::Sonify},
+    {"journal", CommandId::Journal},
+    {"replay", CommandId::Replay},
+    {"format", CommandId::Format},
+    {"repeat", CommandId::Repeat},
   };
 
   auto it = kMap.find(op);
@@ -62,6 +75,36 @@ CommandId parseCommandId(const std::string& op) {
   return it->second;
 }
 
+const char* Console::commandName(CommandId cmd) {
+  static const char* const kNames[] = {
+    "help", "quit", "mode", "cap", "set", "flip", "shift", "tick", "print", "regs",
+    "run", "step", "glyph", "dial", "clock", "windows", "calc", "equation", "sonify",
+    "journal", "replay", "format", "repeat", "unknown",
+  };
+  static_assert(sizeof(kNames) / sizeof(kNames[0]) == (std::size_t)CommandId::Unknown + 1, "command name table");
+  static_assert((int)CommandId::Unknown < IoClock::kMaxCommandKinds, "too many commands for IoClock");
+  return kNames[(std::size_t)cmd];
+}
+
+namespace {
+
+// Throws the usage line when a command has fewer than n tokens (name
+// included), before anything indexes past the end.
+void need(const std::vector<std::string>& t, std::size_t n, const char* usage) {
+  if (t.size() < n) throw std::invalid_argument(usage);
+}
+
+// Appends the decimal digits of v without going through a stream.
+void append_u64(std::string& out, std::uint64_t v) {
+  char buf[20];
+  char* p = buf + sizeof(buf);
+  do {
+    *--p = (char)('0' + v % 10);
+    v /= 10;
+  } while (v != 0);
+  out.append(p, (std::size_t)(buf + sizeof(buf) - p));
+}
+
 std::string joinTokens(const std::vector<std::string>& tokens, std::size_t start) {
   if (start >= tokens.size()) return {};
   std::ostringstream oss;
@@ -80,98 +123,254 @@ void IoClock::onCommand() {
   commandCount_++;
 }
 
+void IoClock::resetLatency() {
+  for (auto& h : latency_) h.reset();
+}
+
 void IoClock::onGearTick(int k) {
   if (k > 0) gearTicks_ += static_cast<std::uint64_t>(k);
 }
 
-std::string IoClock::timeNowString() {
-  const auto now = std::chrono::system_clock::now();
-  const std::time_t tt = std::chrono::system_clock::to_time_t(now);
+void IoClock::addGearTicks(std::uint64_t k) {
+  gearTicks_ += k;
+}
+
+const char* IoClock::timeNow() const {
+  const std::time_t tt = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+  if (tt == cachedSecond_) return cachedTime_;
   std::tm localTm{};
 #if defined(_WIN32)
   localtime_s(&localTm, &tt);
 #else
-  localTm = *std::localtime(&tt);
+  localtime_r(&tt, &localTm);
 #endif
-  std::ostringstream oss;
-  oss << std::put_time(&localTm, "%H:%M:%S");
-  return oss.str();
+  cachedTime_[0] = (char)('0' + localTm.tm_hour / 10);
+  cachedTime_[1] = (char)('0' + localTm.tm_hour % 10);
+  cachedTime_[2] = ':';
+  cachedTime_[3] = (char)('0' + localTm.tm_min / 10);
+  cachedTime_[4] = (char)('0' + localTm.tm_min % 10);
+  cachedTime_[5] = ':';
+  cachedTime_[6] = (char)('0' + localTm.tm_sec / 10);
+  cachedTime_[7] = (char)('0' + localTm.tm_sec % 10);
+  cachedTime_[8] = '\0';
+  cachedSecond_ = tt;
+  return cachedTime_;
 }
 
 std::string IoClock::promptTag() const {
-  std::ostringstream oss;
-  oss << "[clk " << timeNowString() << " cmd=" << commandCount_ << " ticks=" << gearTicks_ << "]";
-  return oss.str();
+  std::string out;
+  out.reserve(64);
+  out += "[clk ";
+  out.append(timeNow(), 8);
+  out += " cmd=";
+  append_u64(out, commandCount_);
+  out += " ticks=";
+  append_u64(out, gearTicks_);
+  out += ']';
+  return out;
 }
 
-std::string IoClock::stamp(const char* channel, const std::string& msg) const {
-  std::ostringstream oss;
-  oss << "[" << timeNowString() << "][" << channel << "][ticks=" << gearTicks_ << "] " << msg;
-  return oss.str();
+std::string IoClock::stamp(const char* channel, std::string_view msg) const {
+  std::string out;
+  stampInto(out, channel, msg);
+  return out;
+}
+
+void IoClock::stampInto(std::string& out, const char* channel, std::string_view msg) const {
+  out.clear();
+  out.reserve(40 + msg.size());
+  out += '[';
+  out.append(timeNow(), 8);
+  out += "][";
+  out += channel;
+  out += "][ticks=";
+  append_u64(out, gearTicks_);
+  out += "] ";
+  out += msg;
 }
 
-void WindowApi::pushLine(std::deque<std::string>& pane, const std::string& line) {
-  pane.push_back(line);
-  while (pane.size() > maxLines_) pane.pop_front();
+WindowApi::WindowApi(std::size_t maxLines, std::size_t lineBytes) : maxLines_(maxLines == 0 ? 1 : maxLines) {
+  const std::size_t paneBytes = maxLines_ * (lineBytes == 0 ? 1 : lineBytes);
+  arena_.resize(paneBytes * kPaneCount);
+  for (int p = 0; p < kPaneCount; ++p) {
+    panes_[p].base = (std::size_t)p * paneBytes;
+    panes_[p].bytes = paneBytes;
+    panes_[p].slots.resize(maxLines_);
+  }
+}
+
+void WindowApi::dropOldest(Pane& pane) {
+  pane.used -= pane.slots[pane.head].length;
+  pane.head = (pane.head + 1) % maxLines_;
+  pane.count--;
+}
+
+void WindowApi::pushLine(Pane& pane, std::string_view line) {
+  const std::size_t len = std::min(line.size(), pane.bytes);
+  while (pane.count > 0 && (pane.count == maxLines_ || pane.used + len > pane.bytes)) dropOldest(pane);
+
+  char* region = arena_.data() + pane.base;
+  const std::size_t first = std::min(len, pane.bytes - pane.write);
+  std::copy_n(line.data(), first, region + pane.write);
+  std::copy_n(line.data() + first, len - first, region);
+
+  pane.slots[(pane.head + pane.count) % maxLines_] = Slot{pane.write, len};
+  pane.count++;
+  pane.used += len;
+  pane.write = (pane.write + len) % pane.bytes;
 }
 
-void WindowApi::pushInput(const std::string& line) {
-  pushLine(input_, line);
+void WindowApi::pushInput(std::string_view line) {
+  pushLine(panes_[kInput], line);
 }
 
-void WindowApi::pushOutput(const std::string& line) {
-  pushLine(output_, line);
+void WindowApi::pushOutput(std::string_view line) {
+  pushLine(panes_[kOutput], line);
 }
 
-void WindowApi::pushEvent(const std::string& line) {
-  pushLine(events_, line);
+void WindowApi::pushEvent(std::string_view line) {
+  pushLine(panes_[kEvents], line);
 }
 
 std::string WindowApi::inputPrompt() const {
   return "wa[in]> ";
 }
 
-std::string WindowApi::renderPane(const char* title, const std::deque<std::string>& pane) const {
-  std::ostringstream oss;
-  oss << "=== " << title << " ===\n";
-  for (const auto& line : pane) oss << line << "\n";
-  return oss.str();
+void WindowApi::renderPane(const char* title, const Pane& pane, std::string& sink) const {
+  sink += "=== ";
+  sink += title;
+  sink += " ===\n";
+  const char* region = arena_.data() + pane.base;
+  for (std::size_t i = 0; i < pane.count; ++i) {
+    const Slot& s = pane.slots[(pane.head + i) % maxLines_];
+    const std::size_t first = std::min(s.length, pane.bytes - s.offset);
+    sink.append(region + s.offset, first);
+    sink.append(region, s.length - first);
+    sink += '\n';
+  }
 }
 
-std::string WindowApi::renderInput() const {
-  return renderPane("Input", input_);
+void WindowApi::renderInput(std::string& sink) const {
+  renderPane("Input", panes_[kInput], sink);
 }
 
-std::string WindowApi::renderOutput() const {
-  return renderPane("Output", output_);
+void WindowApi::renderOutput(std::string& sink) const {
+  renderPane("Output", panes_[kOutput], sink);
 }
 
-std::string WindowApi::renderEvents() const {
-  return renderPane("Events", events_);
+void WindowApi::renderEvents(std::string& sink) const {
+  renderPane("Events", panes_[kEvents], sink);
+}
+
+void WindowApi::renderAll(std::string& sink) const {
+  renderInput(sink);
+  renderOutput(sink);
+  renderEvents(sink);
 }
 
 std::string WindowApi::renderAll() const {
-  std::ostringstream oss;
-  oss << renderInput() << renderOutput() << renderEvents();
-  return oss.str();
+  std::string out;
+  renderAll(out);
+  return out;
 }
 
 Console::Console(Machine& m, ConsoleConfig cfg) : m_(m), cfg_(cfg), windows_(128) {
   cpu_ = std::make_unique<CPU64>(m_);
+  if (cfg_.stdoutWriter) writer_ = std::make_unique<OutputWriter>(std::cout);
+  json_ = cfg_.json;
+}
+
+Console::~Console() {
+  syncOutput();
+}
+
+void Console::writeOut(std::string_view text) {
+  if (quiet_) return;
+  outBuf_ += text;
+  if (outBuf_.size() >= kOutFlushBytes) flushOutput();
+}
+
+void Console::flushOutput() {
+  if (outBuf_.empty() || !writer_) return;
+  writer_->write(std::move(outBuf_));
+  outBuf_.clear();
+  outBuf_.reserve(kOutFlushBytes);
+}
+
+void Console::syncOutput() {
+  flushOutput();
+  if (writer_) writer_->flush();
+}
+
+void Console::takeOutput(std::string& out) {
+  out += outBuf_;
+  outBuf_.clear();
+}
+
+void Console::greet() {
+  emitOutput("WolfmanAlpha Gear Console (CPU + Zodiac)");
+  emitOutput("Type 'help' for commands.");
+}
+
+// Empty in JSON mode, so every output line is one parseable object.
+std::string Console::prompt() const {
+  if (json_) return {};
+  return clock_.promptTag() + " " + windows_.inputPrompt();
+}
+
+bool Console::executeLine(const std::string& line) {
+  return execute(line) != LineResult::Quit;
 }
 
 void Console::emitOutput(const std::string& msg) {
-  const std::string stamped = clock_.stamp("OUT", msg);
-  windows_.pushOutput(stamped);
-  std::cout << stamped << "\n";
+  if (muted_) return;
+  clock_.stampInto(stampBuf_, "OUT", msg);
+  windows_.pushOutput(stampBuf_);
+  if (json_) {
+    emitText(msg);
+    return;
+  }
+  writeOut(stampOutput_ ? std::string_view(stampBuf_) : std::string_view(msg));
+  writeOut("\n");
+}
+
+// Free text from a command: written as-is in text mode, collected into the
+// command's "out" array in JSON mode.
+void Console::emitText(std::string_view text) {
+  if (muted_) return;
+  if (!json_) {
+    writeOut(text);
+    return;
+  }
+  if (!jsonMsgs_.empty()) jsonMsgs_ += ',';
+  JsonLine::appendString(jsonMsgs_, text);
+}
+
+// Streams a ring dump through writeOut in chunks, so the output buffer
+// flushes as it fills instead of holding the whole dump. Only the header
+// line goes to the Output pane.
+void Console::printRing(int r, int count, DumpFormat fmt) {
+  if (muted_) return;
+  const Ring& rg = m_.ring(r);
+  const std::string header = "Ring " + std::to_string(r) + " dir=" + to_string(rg.dir()) + " offset=" +
+                             std::to_string(rg.offset()) + (fmt == DumpFormat::Hex ? " hex:" : " bits:");
+  clock_.stampInto(stampBuf_, "OUT", header);
+  windows_.pushOutput(stampBuf_);
+  if (quiet_) return;
+  writeOut(stampOutput_ ? std::string_view(stampBuf_) : std::string_view(header));
+  m_.dumpRingTo(r, count, fmt, [this](std::string_view chunk) { writeOut(chunk); });
+  writeOut("\n");
 }
 
 void Console::emitEvent(const std::string& msg) {
-  windows_.pushEvent(clock_.stamp("EVT", msg));
+  if (muted_) return;
+  clock_.stampInto(stampBuf_, "EVT", msg);
+  windows_.pushEvent(stampBuf_);
 }
 
 void Console::recordInput(const std::string& line) {
-  windows_.pushInput(clock_.stamp("IN", line));
+  clock_.stampInto(stampBuf_, "IN", line);
+  windows_.pushInput(stampBuf_);
 }
 
 std::vector<std::string> Console::split(const std::string& s) {
@@ -210,24 +409,146 @@ std::string Console::glyphName(Zodiac13 g) {
   return std::string(ZodiacNames[(int)g]);
 }
 
-void Console::dialRingToGlyph(int ring, Zodiac13 target) {
-  const int maxSteps = m_.gearsPerRing() * 2;
-  for (int step=0; step<maxSteps; step++) {
-    auto cur = activeGlyphFromOffset(m_.ring(ring).offset(), m_.gearsPerRing());
-    if (cur == target) return;
+// Closed form: if the ring is outside the target glyph's index range, take
+// the shortest rotation to the nearer end of the range in a single shift.
+int Console::dialRingToGlyph(int ring, Zodiac13 target) {
+  Ring& rg = m_.ring(ring);
+  const int n = rg.gearCount();
+  int first = 0, last = 0;
+  if (!glyphIndexRange(target, n, first, last)) {
+    throw std::invalid_argument("ring too small for glyph " + glyphName(target));
+  }
+  const int cur = math::normalize_mod(rg.offset(), n);
+  if (cur >= first && cur <= last) return 0;
+
+  const int toFirst = math::shortest_signed_steps(cur, first, n);
+  const int toLast = math::shortest_signed_steps(cur, last, n);
+  const int steps = (std::abs(toFirst) <= std::abs(toLast)) ? toFirst : toLast;
+  // LEFT increases the offset, RIGHT decreases it.
+  if (steps > 0) rg.shift(Dir::Left, steps);
+  else           rg.shift(Dir::Right, -steps);
+  return std::abs(steps);
+}
+
+void Console::emitLinearSolution(const calc::LinearEquationResult& res) {
+  if (res.kind == calc::LinearSolveKind::OneSolution) {
+    if (jsonFields()) {
+      jsonLine_.field("solution", "one").field("x", res.x);
+      return;
+    }
+    std::ostringstream oss;
+    oss << "x = " << std::setprecision(15) << res.x;
+    emitOutput(oss.str());
+  } else if (res.kind == calc::LinearSolveKind::InfiniteSolutions) {
+    if (jsonFields()) jsonLine_.field("solution", "infinite");
+    else emitOutput("Infinite solutions");
+  } else {
+    if (jsonFields()) jsonLine_.field("solution", "none");
+    else emitOutput("No solution");
+  }
+}
+
+// One entry per command kind that has run: p50/p99/max latency and
+// throughput over the time spent inside that command.
+void Console::clockStats() {
+  if (muted_) return;
+  if (jsonFields()) jsonLine_.beginArray("stats");
+  for (int k = 0; k <= (int)CommandId::Unknown; ++k) {
+    const LatencyHistogram& h = clock_.latency(k);
+    if (h.count() == 0) continue;
+    const double opsPerSec = h.sum() ? (double)h.count() * 1e9 / (double)h.sum() : 0.0;
+    const char* name = commandName((CommandId)k);
+    if (jsonFields()) {
+      std::string& out = jsonLine_.elementRaw();
+      out += "{\"cmd\":\"";
+      out += name;
+      out += "\",\"count\":";
+      append_u64(out, h.count());
+      out += ",\"p50_ns\":";
+      append_u64(out, h.percentile(0.50));
+      out += ",\"p99_ns\":";
+      append_u64(out, h.percentile(0.99));
+      out += ",\"max_ns\":";
+      append_u64(out, h.max());
+      out += ",\"ops_per_s\":";
+      append_u64(out, (std::uint64_t)opsPerSec);
+      out += '}';
+      continue;
+    }
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(2) << std::left << std::setw(9) << name
+        << " n=" << h.count() << " p50=" << h.percentile(0.50) / 1e3 << "us p99=" << h.percentile(0.99) / 1e3
+        << "us max=" << h.max() / 1e3 << "us ops/s=" << std::setprecision(0) << opsPerSec;
+    emitOutput(oss.str());
+  }
+  if (jsonFields()) jsonLine_.endArray();
+}
+
+void Console::requireFileCommands(const char* what) const {
+  if (!cfg_.fileCommands) throw std::invalid_argument(std::string(what) + " is disabled in this session (no file access)");
+}
 
-    int curV = (int)cur;
-    int tgtV = (int)target;
-    int diff = (tgtV - curV);
+void Console::journal(const std::vector<std::string>& t) {
+  std::string sub = (t.size() >= 2) ? t[1] : "status";
+  std::transform(sub.begin(), sub.end(), sub.begin(), ::tolower);
+  if (sub == "on") {
+    requireFileCommands("journal on");
+    if (t.size() < 3) throw std::invalid_argument("journal on <file>");
+    if (journal_.isOpen()) throw std::invalid_argument("journal already recording");
+    if (!journal_.open(t[2], m_, *cpu_)) throw std::runtime_error("cannot open " + t[2]);
+    emitOutput("journal -> " + t[2]);
+  } else if (sub == "off") {
+    if (!journal_.isOpen()) throw std::invalid_argument("journal is not recording");
+    const auto n = journal_.records();
+    if (!journal_.close()) throw std::runtime_error("journal write failed");
+    emitOutput("journal stopped: records=" + std::to_string(n));
+  } else if (sub == "status") {
+    emitOutput(std::string("journal ") + (journal_.isOpen() ? "on" : "off") +
+               " records=" + std::to_string(journal_.records()));
+  } else {
+    throw std::invalid_argument("journal supports: on <file> | off | status");
+  }
+}
 
-    if (diff == 0) return;
-    if (diff > 0) m_.shiftRing(ring, Dir::Left, 1);
-    else          m_.shiftRing(ring, Dir::Right, 1);
+bool Console::replay(const std::string& path, ReplayStats& stats) {
+  if (journal_.isOpen()) throw std::invalid_argument("stop the journal before replaying");
+  const bool ok = replay_journal(path, m_, cpu_, stats);
+  clock_.addGearTicks(stats.gearTicks);
+  if (sonifier_ && sonifier_->running()) cpu_->attachSoundEvents(soundQueue_.get());
+  return ok;
+}
+
+void Console::sonify(const std::vector<std::string>& t) {
+  std::string sub = (t.size() >= 2) ? t[1] : "status";
+  std::transform(sub.begin(), sub.end(), sub.begin(), ::tolower);
+  if (sub == "on") {
+    requireFileCommands("sonify on");
+    if (t.size() < 3) throw std::invalid_argument("sonify on <file.wav>");
+    if (sonifier_ && sonifier_->running()) throw std::invalid_argument("sonify already running");
+    if (!soundQueue_) soundQueue_ = std::make_unique<SoundEventQueue>();
+    sonifier_ = std::make_unique<audio::EventSonifier>(*soundQueue_);
+    if (!sonifier_->start(t[2])) throw std::runtime_error("cannot open " + t[2]);
+    cpu_->attachSoundEvents(soundQueue_.get());
+    emitOutput("sonify -> " + t[2]);
+  } else if (sub == "off") {
+    if (!sonifier_ || !sonifier_->running()) throw std::invalid_argument("sonify is not running");
+    const u64 dropped = cpu_->soundEvents().dropped();
+    cpu_->attachSoundEvents(nullptr);
+    sonifier_->stop();
+    emitOutput("sonify stopped: events=" + std::to_string(sonifier_->eventsRendered()) +
+               " dropped=" + std::to_string(dropped) +
+               " samples=" + std::to_string(sonifier_->samplesWritten()));
+  } else if (sub == "status") {
+    const bool on = sonifier_ && sonifier_->running();
+    emitOutput(std::string("sonify ") + (on ? "on" : "off") +
+               " dropped=" + std::to_string(cpu_->soundEvents().dropped()));
+  } else {
+    throw std::invalid_argument("sonify supports: on <file.wav> | off | status");
   }
 }
 
-void Console::help() const {
-  std::cout <<
+void Console::help() {
+  emitText(
     "Commands:\n"
     "  help\n"
     "  mode 64|360|720           # select CPU profile\n"
@@ -236,13 +557,15 @@ void Console::help() const {
     "  flip r i\n"
     "  shift r LEFT|RIGHT k      # stargate ring shift\n"
     "  tick k                    # tick all rings by their current dir\n"
-    "  print r [count]\n"
+    "  print r [n|all] [bits|hex]\n"
     "  regs [countBits]          # dump CPU registers (first N bits)\n"
     "  run n                     # run n CPU steps\n"
     "  step                      # run 1 CPU step\n"
     "  glyph r                   # show active glyph on ring r\n"
-    "  dial r Z0..Z12            # rotate ring until target glyph is active\n"
+    "  dial r Z0..Z12 [r Z ...]  # rotate ring(s) the short way to the glyph\n"
+    "  dial * Z0..Z12            # dial every ring\n"
     "  clock status|tick [n]     # clock/gear tick controls\n"
+    "  clock stats [reset]       # per-command p50/p99/max latency and ops/s\n"
     "  calc eval <expr>          # arithmetic/formal expression evaluator\n"
     "  calc evalx <x> <expr>     # evaluate expression using variable x\n"
     "  calc deriv <x> <expr>     # numeric derivative d/dx at x\n"
@@ -250,249 +573,591 @@ void Console::help() const {
     "  calc quad <a> <b> <c>     # solve a*x^2 + b*x + c = 0\n"
     "  calc solve <equation>     # solve linear equation with x (example: 2*x+3=9)\n"
     "  equation <lhs=rhs>        # alias of calc solve\n"
+    "  sonify on <file>|off      # mix CPU events into a WAV stream\n"
+    "  journal on <file>|off     # record state changes to a binary journal\n"
+    "  replay <file>             # re-apply a journal at full speed\n"
+    "  format text|json          # json: one JSON object per command\n"
+    "  a; b; c                   # run commands in order, stop at the first error\n"
+    "  repeat N [verbose] { ... } # run a parsed block N times with output muted\n"
     "  windows                   # render input/output/event panes\n"
-    "  quit\n";
+    "  quit\n");
 }
 
 void Console::repl() {
-  emitOutput("WolfmanAlpha Gear Console (CPU + Zodiac)");
-  emitOutput("Type 'help' for commands.");
+  greet();
 
   std::string line;
   while (true) {
-    std::cout << clock_.promptTag() << " " << windows_.inputPrompt() << std::flush;
+    // Explicit flush point: everything emitted so far, then the prompt, is
+    // on the terminal before we block on input.
+    writeOut(prompt());
+    syncOutput();
     if (!std::getline(std::cin, line)) break;
-    clock_.onCommand();
-    recordInput(line);
-
-    auto t = split(line);
-    if (t.empty()) continue;
-
-    try {
-      std::string op = t[0];
-      std::transform(op.begin(), op.end(), op.begin(), ::tolower);
-      const auto cmd = parseCommandId(op);
-
-      switch (cmd) {
-        case CommandId::Help:
-          help();
-          break;
-
-        case CommandId::Quit:
-          return;
-
-        case CommandId::Mode: {
-          int mode = toInt(t[1]);
-          if (mode == 64) cpu_ = std::make_unique<CPU64>(m_);
-          else if (mode == 360) cpu_ = std::make_unique<CPU360>(m_);
-          else if (mode == 720) cpu_ = std::make_unique<CPU720>(m_);
-          else throw std::invalid_argument("mode must be 64, 360, or 720");
-          emitOutput("CPU mode set to " + std::to_string(mode));
-          break;
-        }
+    if (execute(line) == LineResult::Quit) break;
+  }
+  syncOutput();
+}
 
-        case CommandId::Cap: {
-          int mode = (t.size() >= 2) ? toInt(t[1]) : 2;
-          emitOutput(m_.capacityString(mode == 2));
-          break;
-        }
+BatchStats Console::runBatch(std::istream& in, const BatchOptions& opts) {
+  const bool prevQuiet = quiet_;
+  const bool prevStamp = stampOutput_;
+  quiet_ = opts.quiet;
+  stampOutput_ = opts.timestamps;
 
-        case CommandId::Set: {
-          int r = toInt(t[1]);
-          int i = toInt(t[2]);
-          int v = toInt(t[3]);
-          m_.setBit(r, i, (u8)v);
-          emitEvent("set ring=" + std::to_string(r) + " idx=" + std::to_string(i) + " v=" + std::to_string(v));
-          break;
-        }
+  BatchStats stats;
+  const auto t0 = std::chrono::steady_clock::now();
+  std::uint64_t lineNo = 0;
+  for (std::string line; std::getline(in, line);) {
+    ++lineNo;
+    const auto r = execute(line);
+    if (r == LineResult::Quit) break;
+    ++stats.commands;
+    if (r == LineResult::Error) {
+      ++stats.errors;
+      std::cerr << "line " << lineNo << ": " << lastError_ << "\n";
+    }
+  }
+  syncOutput();
+  stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
 
-        case CommandId::Flip: {
-          int r = toInt(t[1]);
-          int i = toInt(t[2]);
-          m_.flipBit(r, i);
-          emitEvent("flip ring=" + std::to_string(r) + " idx=" + std::to_string(i));
-          break;
-        }
+  quiet_ = prevQuiet;
+  stampOutput_ = prevStamp;
+  return stats;
+}
 
-        case CommandId::Shift: {
-          int r = toInt(t[1]);
-          Dir d = parseDir(t[2]);
-          int k = (t.size() >= 4) ? toInt(t[3]) : 1;
-          m_.shiftRing(r, d, k);
-          emitEvent("shift ring=" + std::to_string(r) + " steps=" + std::to_string(k));
-          break;
-        }
+Console::LineResult Console::execute(const std::string& line) {
+  if (line.find_first_of(";{}") != std::string::npos) return executeScript(line);
 
-        case CommandId::Tick: {
-          int k = (t.size() >= 2) ? toInt(t[1]) : 1;
-          m_.tickAll(k);
-          clock_.onGearTick(k);
-          emitEvent("tick +" + std::to_string(k) + " (total=" + std::to_string(clock_.gearTicks()) + ")");
-          break;
+  clock_.onCommand();
+  recordInput(line);
+
+  auto t = split(line);
+  if (t.empty()) return LineResult::Ok;
+
+  std::string op = t[0];
+  std::transform(op.begin(), op.end(), op.begin(), ::tolower);
+  return runCommand(parseCommandId(op), op, t);
+}
+
+namespace {
+
+std::uint64_t elapsed_ns(std::chrono::steady_clock::time_point t0) {
+  return (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// Splits a script line into words, with ';', '{' and '}' as tokens of their own.
+std::vector<std::string> tokenizeScript(const std::string& line) {
+  std::vector<std::string> out;
+  std::string cur;
+  for (char c : line) {
+    if (std::isspace((unsigned char)c) || c == ';' || c == '{' || c == '}') {
+      if (!cur.empty()) out.push_back(std::move(cur));
+      cur.clear();
+      if (!std::isspace((unsigned char)c)) out.emplace_back(1, c);
+    } else {
+      cur += c;
+    }
+  }
+  if (!cur.empty()) out.push_back(std::move(cur));
+  return out;
+}
+
+} // namespace
+
+void Console::beginJson(const std::string& op, std::uint64_t n) {
+  jsonMsgs_.clear();
+  jsonLine_.begin();
+  jsonLine_.field("cmd", op).field("n", n);
+}
+
+void Console::endJson(LineResult r) {
+  if (!jsonMsgs_.empty()) {
+    std::string& out = jsonLine_.raw("out");
+    out += '[';
+    out += jsonMsgs_;
+    out += ']';
+  }
+  jsonLine_.field("ticks", clock_.gearTicks()).field("ok", r != LineResult::Error);
+  if (r == LineResult::Error) jsonLine_.field("error", lastError_);
+  writeOut(jsonLine_.end());
+}
+
+// `a; b; c` and `repeat N [verbose] { ... }` (blocks nest). The line is parsed
+// once into ScriptNodes, so repeated commands skip tokenizing and lookup.
+Console::LineResult Console::executeScript(const std::string& line) {
+  recordInput(line);
+  const auto tok = tokenizeScript(line);
+  std::size_t pos = 0;
+
+  std::function<void(std::vector<ScriptNode>&, bool)> parseBlock = [&](std::vector<ScriptNode>& out, bool inBraces) {
+    while (pos < tok.size()) {
+      if (tok[pos] == ";") {
+        ++pos;
+        continue;
+      }
+      if (tok[pos] == "}") {
+        if (!inBraces) throw std::invalid_argument("unexpected '}'");
+        ++pos;
+        return;
+      }
+      if (tok[pos] == "{") throw std::invalid_argument("unexpected '{'");
+
+      ScriptNode node;
+      node.op = tok[pos];
+      std::transform(node.op.begin(), node.op.end(), node.op.begin(), ::tolower);
+      node.cmd = parseCommandId(node.op);
+      if (node.cmd == CommandId::Repeat) {
+        if (pos + 1 >= tok.size()) throw std::invalid_argument("repeat N [verbose] { ... }");
+        node.repeat = toInt(tok[pos + 1]);
+        if (node.repeat < 0) throw std::invalid_argument("repeat count must be >= 0");
+        pos += 2;
+        if (pos < tok.size() && tok[pos] == "verbose") {
+          node.verbose = true;
+          ++pos;
         }
+        if (pos >= tok.size() || tok[pos] != "{") throw std::invalid_argument("repeat N [verbose] { ... }");
+        ++pos;
+        parseBlock(node.body, true);
+      } else {
+        while (pos < tok.size() && tok[pos] != ";" && tok[pos] != "}" && tok[pos] != "{") node.tokens.push_back(tok[pos++]);
+        if (pos < tok.size() && tok[pos] == "{") throw std::invalid_argument("unexpected '{' after " + node.op);
+      }
+      out.push_back(std::move(node));
+    }
+    if (inBraces) throw std::invalid_argument("missing '}'");
+  };
+
+  std::vector<ScriptNode> nodes;
+  try {
+    parseBlock(nodes, false);
+  } catch (const std::exception& e) {
+    clock_.onCommand();
+    lastError_ = e.what();
+    if (json_) {
+      beginJson(tok.empty() ? std::string() : tok[0], clock_.commandCount());
+      endJson(LineResult::Error);
+    } else {
+      emitOutput("Error: " + lastError_);
+    }
+    return LineResult::Error;
+  }
+  return runNodes(nodes);
+}
 
-        case CommandId::Print: {
-          int r = toInt(t[1]);
-          int c = (t.size() >= 3) ? toInt(t[2]) : cfg_.printCount;
-          emitOutput(m_.dumpRing(r, c));
-          break;
+// Stops at the first failing command or `quit`.
+Console::LineResult Console::runNodes(const std::vector<ScriptNode>& nodes) {
+  for (const auto& node : nodes) {
+    LineResult r;
+    if (node.cmd == CommandId::Repeat) {
+      r = runRepeat(node);
+    } else {
+      clock_.onCommand();
+      r = runCommand(node.cmd, node.op, node.tokens);
+    }
+    if (r != LineResult::Ok) return r;
+  }
+  return LineResult::Ok;
+}
+
+Console::LineResult Console::runRepeat(const ScriptNode& node) {
+  clock_.onCommand();
+  const std::uint64_t n = clock_.commandCount();
+  // Muting covers text, events, pane pushes and JSON envelopes; mode
+  // changes made by the body (e.g. `format`) persist.
+  const bool prevMuted = muted_;
+  if (!node.verbose) muted_ = true;
+  LineResult r = LineResult::Ok;
+  int done = 0;
+  const auto t0 = std::chrono::steady_clock::now();
+  for (; done < node.repeat && r == LineResult::Ok; ++done) r = runNodes(node.body);
+  clock_.recordLatency((int)CommandId::Repeat, elapsed_ns(t0));
+  if (r != LineResult::Ok) --done; // the failing iteration did not complete
+  muted_ = prevMuted;
+  if (r == LineResult::Quit) return r;
+
+  if (r == LineResult::Error && !node.verbose) lastError_ += " (repeat iteration " + std::to_string(done + 1) + ")";
+  if (muted_) return r; // nested in a muted block: nothing to report
+  const std::uint64_t commands = clock_.commandCount() - n;
+  if (json_) {
+    beginJson(node.op, n);
+    jsonLine_.field("iterations", done).field("commands", commands);
+    endJson(r);
+  } else if (r == LineResult::Error) {
+    if (!node.verbose) emitOutput("Error: " + lastError_);
+  } else {
+    emitOutput("repeat: " + std::to_string(done) + " iterations, " + std::to_string(commands) + " commands");
+  }
+  return r;
+}
+
+// Times dispatch() alone into the command's latency histogram; the JSON
+// envelope is formatting, not the command.
+Console::LineResult Console::runCommand(CommandId cmd, const std::string& op, const std::vector<std::string>& t) {
+  const bool json = jsonFields(); // `format` may flip json_ mid-command
+  const std::uint64_t n = clock_.commandCount();
+  if (json) beginJson(op, n);
+  const auto t0 = std::chrono::steady_clock::now();
+  const LineResult r = dispatch(cmd, t);
+  clock_.recordLatency((int)cmd, elapsed_ns(t0));
+  if (cmd == CommandId::Format && r == LineResult::Ok) {
+    // `format` answers in the mode it leaves the console in.
+    if (!json_) {
+      emitOutput("Output format: text");
+    } else if (!muted_) {
+      beginJson(op, n);
+      jsonLine_.field("format", "json");
+      endJson(r);
+    }
+    return r;
+  }
+  if (json) endJson(r);
+  return r;
+}
+
+Console::LineResult Console::dispatch(CommandId cmd, const std::vector<std::string>& t) {
+  try {
+    switch (cmd) {
+      case CommandId::Help:
+        help();
+        break;
+
+      case CommandId::Quit:
+        return LineResult::Quit;
+
+      case CommandId::Mode: {
+        need(t, 2, "mode 64|360|720");
+        int mode = toInt(t[1]);
+        cpu_ = make_cpu(mode, m_);
+        journal_.mode(mode);
+        if (sonifier_ && sonifier_->running()) cpu_->attachSoundEvents(soundQueue_.get());
+        if (jsonFields()) jsonLine_.field("mode", mode);
+        else emitOutput("CPU mode set to " + std::to_string(mode));
+        break;
+      }
+
+      case CommandId::Cap: {
+        int mode = (t.size() >= 2) ? toInt(t[1]) : 2;
+        emitOutput(m_.capacityString(mode == 2));
+        break;
+      }
+
+      case CommandId::Set: {
+        need(t, 4, "set r i v");
+        int r = toInt(t[1]);
+        int i = toInt(t[2]);
+        int v = toInt(t[3]);
+        m_.setBit(r, i, (u8)v);
+        journal_.set(r, i, v);
+        if (!muted_) emitEvent("set ring=" + std::to_string(r) + " idx=" + std::to_string(i) + " v=" + std::to_string(v));
+        break;
+      }
+
+      case CommandId::Flip: {
+        need(t, 3, "flip r i");
+        int r = toInt(t[1]);
+        int i = toInt(t[2]);
+        m_.flipBit(r, i);
+        journal_.flip(r, i);
+        if (!muted_) emitEvent("flip ring=" + std::to_string(r) + " idx=" + std::to_string(i));
+        break;
+      }
+
+      case CommandId::Shift: {
+        need(t, 3, "shift r LEFT|RIGHT [k]");
+        int r = toInt(t[1]);
+        Dir d = parseDir(t[2]);
+        int k = (t.size() >= 4) ? toInt(t[3]) : 1;
+        m_.shiftRing(r, d, k);
+        journal_.shift(r, d, k);
+        if (!muted_) emitEvent("shift ring=" + std::to_string(r) + " steps=" + std::to_string(k));
+        break;
+      }
+
+      case CommandId::Tick: {
+        int k = (t.size() >= 2) ? toInt(t[1]) : 1;
+        m_.tickAll(k);
+        clock_.onGearTick(k);
+        journal_.tick(k);
+        if (!muted_) emitEvent("tick +" + std::to_string(k) + " (total=" + std::to_string(clock_.gearTicks()) + ")");
+        break;
+      }
+
+      case CommandId::Print: {
+        need(t, 2, "print r [count|all] [bits|hex]");
+        int r = toInt(t[1]);
+        const Ring& rg = m_.ring(r);
+        int c = cfg_.printCount;
+        if (t.size() >= 3) c = (t[2] == "all") ? rg.gearCount() : toInt(t[2]);
+        std::string f = (t.size() >= 4) ? t[3] : (json_ ? "hex" : "bits");
+        std::transform(f.begin(), f.end(), f.begin(), ::tolower);
+        if (f != "bits" && f != "hex") throw std::invalid_argument("print r [count|all] [bits|hex]");
+        const DumpFormat fmt = (f == "hex") ? DumpFormat::Hex : DumpFormat::Bits;
+        const int count = std::max(0, std::min(c, rg.gearCount()));
+        if (jsonFields()) {
+          jsonLine_.field("ring", r).field("dir", to_string(rg.dir())).field("offset", rg.offset()).field("count", count);
+          std::string& out = jsonLine_.raw(f == "hex" ? "hex" : "bits");
+          out += '"';
+          m_.dumpRingTo(r, count, fmt, [&](std::string_view chunk) { out += chunk; });
+          out += '"';
+        } else {
+          printRing(r, count, fmt);
         }
+        break;
+      }
 
-        case CommandId::Regs: {
-          int c = (t.size() >= 2) ? toInt(t[1]) : 64;
+      case CommandId::Regs: {
+        int c = (t.size() >= 2) ? toInt(t[1]) : 64;
+        if (jsonFields()) {
+          const int count = std::min(c, cpu_->wordBits());
+          jsonLine_.field("bits", count).beginArray("hex");
+          for (int reg = 0; reg < cpu_->regCount(); ++reg) {
+            std::string& out = jsonLine_.elementRaw();
+            out += '"';
+            append_hex_bits(out, count, [&](int i) { return cpu_->regBit(reg, i); });
+            out += '"';
+          }
+          jsonLine_.endArray();
+        } else if (!muted_) {
           emitOutput(cpu_->regDump(c));
-          break;
         }
+        break;
+      }
 
-        case CommandId::Run: {
-          int n = toInt(t[1]);
-          for (int i = 0; i < n && !cpu_->halted(); i++) cpu_->step();
-          emitOutput("ran " + std::to_string(n) + " steps");
-          break;
-        }
+      case CommandId::Run: {
+        need(t, 2, "run n");
+        int n = toInt(t[1]);
+        for (int i = 0; i < n && !cpu_->halted(); i++) cpu_->step();
+        journal_.run(n);
+        if (jsonFields()) jsonLine_.field("steps", n).field("cycles", cpu_->cycles()).field("halted", cpu_->halted());
+        else emitOutput("ran " + std::to_string(n) + " steps");
+        break;
+      }
 
-        case CommandId::Step:
-          cpu_->step();
-          emitOutput("ok");
-          break;
+      case CommandId::Step:
+        cpu_->step();
+        journal_.run(1);
+        if (jsonFields()) jsonLine_.field("cycles", cpu_->cycles()).field("halted", cpu_->halted());
+        else emitOutput("ok");
+        break;
 
-        case CommandId::Glyph: {
-          int r = toInt(t[1]);
-          auto g = activeGlyphFromOffset(m_.ring(r).offset(), m_.gearsPerRing());
-          emitOutput("Ring " + std::to_string(r) + " active glyph = " + glyphName(g));
-          break;
-        }
+      case CommandId::Glyph: {
+        need(t, 2, "glyph r");
+        int r = toInt(t[1]);
+        auto g = activeGlyphFromOffset(m_.ring(r).offset(), m_.gearsPerRing());
+        if (jsonFields()) jsonLine_.field("ring", r).field("glyph", ZodiacNames[(int)g]).field("offset", m_.ring(r).offset());
+        else emitOutput("Ring " + std::to_string(r) + " active glyph = " + glyphName(g));
+        break;
+      }
 
-        case CommandId::Dial: {
-          int r = toInt(t[1]);
-          auto target = parseGlyph(t[2]);
-          dialRingToGlyph(r, target);
-          auto g = activeGlyphFromOffset(m_.ring(r).offset(), m_.gearsPerRing());
-          emitOutput("Ring " + std::to_string(r) + " active glyph = " + glyphName(g));
-          emitEvent("dial ring=" + std::to_string(r) + " -> " + glyphName(target));
-          break;
+      case CommandId::Dial: {
+        // dial r G [r G ...] | dial * G
+        if (t.size() < 3 || (t.size() % 2) == 0) throw std::invalid_argument("dial r Z0..Z12 [r Z0..Z12 ...] | dial * Z0..Z12");
+        std::vector<std::pair<int, Zodiac13>> targets;
+        if (t[1] == "*") {
+          if (t.size() != 3) throw std::invalid_argument("dial * takes one glyph");
+          const auto g = parseGlyph(t[2]);
+          for (int r = 0; r < m_.ringCount(); ++r) targets.emplace_back(r, g);
+        } else {
+          targets.reserve(t.size() / 2);
+          for (std::size_t i = 1; i + 1 < t.size(); i += 2) targets.emplace_back(toInt(t[i]), parseGlyph(t[i + 1]));
         }
+        for (const auto& [r, g] : targets) m_.ring(r); // validate every ring before moving any
 
-        case CommandId::Clock: {
-          std::string sub = (t.size() >= 2) ? t[1] : "status";
-          std::transform(sub.begin(), sub.end(), sub.begin(), ::tolower);
-          if (sub == "status") {
-            emitOutput("clock status: commands=" + std::to_string(clock_.commandCount()) +
-                       " total_ticks=" + std::to_string(clock_.gearTicks()));
-          } else if (sub == "tick") {
-            int k = (t.size() >= 3) ? toInt(t[2]) : 1;
-            m_.tickAll(k);
-            clock_.onGearTick(k);
-            emitEvent("clock tick +" + std::to_string(k) + " (total=" + std::to_string(clock_.gearTicks()) + ")");
+        const bool single = targets.size() == 1;
+        if (jsonFields() && !single) jsonLine_.beginArray("rings");
+        for (const auto& [r, target] : targets) {
+          const bool moved = dialRingToGlyph(r, target) > 0;
+          const Ring& rg = m_.ring(r);
+          journal_.dial(r, moved, rg.dir(), rg.offset());
+          if (jsonFields()) {
+            if (single) {
+              jsonLine_.field("ring", r).field("glyph", ZodiacNames[(int)target]).field("offset", rg.offset());
+            } else {
+              std::string& out = jsonLine_.elementRaw();
+              out += "{\"ring\":";
+              out += std::to_string(r);
+              out += ",\"glyph\":\"";
+              out += ZodiacNames[(int)target];
+              out += "\",\"offset\":";
+              out += std::to_string(rg.offset());
+              out += '}';
+            }
           } else {
-            throw std::invalid_argument("clock supports: status | tick [n]");
+            emitOutput("Ring " + std::to_string(r) + " active glyph = " + glyphName(target));
           }
-          break;
+          if (!muted_) emitEvent("dial ring=" + std::to_string(r) + " -> " + glyphName(target));
         }
+        if (jsonFields() && !single) jsonLine_.endArray();
+        break;
+      }
 
-        case CommandId::Calc: {
-          if (t.size() < 2) {
-            throw std::invalid_argument("calc requires a subcommand");
-          }
-          std::string sub = t[1];
-          std::transform(sub.begin(), sub.end(), sub.begin(), ::tolower);
+      case CommandId::Clock: {
+        std::string sub = (t.size() >= 2) ? t[1] : "status";
+        std::transform(sub.begin(), sub.end(), sub.begin(), ::tolower);
+        if (sub == "status") {
+          if (jsonFields()) jsonLine_.field("commands", clock_.commandCount());
+          else emitOutput("clock status: commands=" + std::to_string(clock_.commandCount()) +
+                          " total_ticks=" + std::to_string(clock_.gearTicks()));
+        } else if (sub == "stats") {
+          if (t.size() >= 3 && t[2] == "reset") clock_.resetLatency();
+          else clockStats();
+        } else if (sub == "tick") {
+          int k = (t.size() >= 3) ? toInt(t[2]) : 1;
+          m_.tickAll(k);
+          clock_.onGearTick(k);
+          journal_.tick(k);
+          if (!muted_) emitEvent("clock tick +" + std::to_string(k) + " (total=" + std::to_string(clock_.gearTicks()) + ")");
+        } else {
+          throw std::invalid_argument("clock supports: status | stats [reset] | tick [n]");
+        }
+        break;
+      }
+
+      case CommandId::Calc: {
+        if (t.size() < 2) {
+          throw std::invalid_argument("calc requires a subcommand");
+        }
+        std::string sub = t[1];
+        std::transform(sub.begin(), sub.end(), sub.begin(), ::tolower);
 
-          if (sub == "eval") {
-            const std::string expr = joinTokens(t, 2);
-            const double v = calc::eval_expr(expr);
+        if (sub == "eval") {
+          const std::string expr = joinTokens(t, 2);
+          const double v = calc::eval_expr(expr);
+          if (jsonFields()) {
+            jsonLine_.field("value", v);
+          } else {
             std::ostringstream oss;
             oss << std::setprecision(15) << v;
             emitOutput(oss.str());
-          } else if (sub == "evalx") {
-            if (t.size() < 4) throw std::invalid_argument("calc evalx <x> <expr>");
-            const double x = std::stod(t[2]);
-            const std::string expr = joinTokens(t, 3);
-            const double v = calc::eval_expr(expr, x);
+          }
+        } else if (sub == "evalx") {
+          if (t.size() < 4) throw std::invalid_argument("calc evalx <x> <expr>");
+          const double x = std::stod(t[2]);
+          const std::string expr = joinTokens(t, 3);
+          const double v = calc::eval_expr(expr, x);
+          if (jsonFields()) {
+            jsonLine_.field("x", x).field("value", v);
+          } else {
             std::ostringstream oss;
             oss << std::setprecision(15) << v;
             emitOutput(oss.str());
-          } else if (sub == "deriv") {
-            if (t.size() < 4) throw std::invalid_argument("calc deriv <x> <expr>");
-            const double x = std::stod(t[2]);
-            const std::string expr = joinTokens(t, 3);
-            const double v = calc::derivative(expr, x);
+          }
+        } else if (sub == "deriv") {
+          if (t.size() < 4) throw std::invalid_argument("calc deriv <x> <expr>");
+          const double x = std::stod(t[2]);
+          const std::string expr = joinTokens(t, 3);
+          const double v = calc::derivative(expr, x);
+          if (jsonFields()) {
+            jsonLine_.field("x", x).field("value", v);
+          } else {
             std::ostringstream oss;
             oss << "d/dx|x=" << std::setprecision(8) << x << " -> " << std::setprecision(15) << v;
             emitOutput(oss.str());
-          } else if (sub == "integ") {
-            if (t.size() < 6) throw std::invalid_argument("calc integ <a> <b> <n> <expr>");
-            const double a = std::stod(t[2]);
-            const double b = std::stod(t[3]);
-            const int n = toInt(t[4]);
-            const std::string expr = joinTokens(t, 5);
-            const double v = calc::integrate(expr, a, b, n);
+          }
+        } else if (sub == "integ") {
+          if (t.size() < 6) throw std::invalid_argument("calc integ <a> <b> <n> <expr>");
+          const double a = std::stod(t[2]);
+          const double b = std::stod(t[3]);
+          const int n = toInt(t[4]);
+          const std::string expr = joinTokens(t, 5);
+          const double v = calc::integrate(expr, a, b, n);
+          if (jsonFields()) {
+            jsonLine_.field("a", a).field("b", b).field("n", n).field("value", v);
+          } else {
             std::ostringstream oss;
             oss << "Integral[" << std::setprecision(8) << a << "," << b << "] = " << std::setprecision(15) << v;
             emitOutput(oss.str());
-          } else if (sub == "quad") {
-            if (t.size() < 5) throw std::invalid_argument("calc quad <a> <b> <c>");
-            const double a = std::stod(t[2]);
-            const double b = std::stod(t[3]);
-            const double c = std::stod(t[4]);
-            const auto qr = calc::solve_quadratic(a, b, c);
-            std::ostringstream oss;
-            if (qr.rootCount == 0) {
-              oss << "No roots";
-            } else if (qr.realRoots) {
-              if (qr.rootCount == 1) {
-                oss << "x = " << std::setprecision(15) << qr.x1;
-              } else {
-                oss << "x1 = " << std::setprecision(15) << qr.x1 << ", x2 = " << qr.x2;
-              }
-            } else {
-              oss << "x = " << std::setprecision(15) << qr.x1 << " +/- " << qr.imag << "i";
-            }
-            emitOutput(oss.str());
-          } else if (sub == "solve") {
-            const std::string eq = joinTokens(t, 2);
-            const auto res = calc::solve_linear_equation(eq);
-            if (res.kind == calc::LinearSolveKind::OneSolution) {
-              std::ostringstream oss;
-              oss << "x = " << std::setprecision(15) << res.x;
-              emitOutput(oss.str());
-            } else if (res.kind == calc::LinearSolveKind::InfiniteSolutions) {
-              emitOutput("Infinite solutions");
+          }
+        } else if (sub == "quad") {
+          if (t.size() < 5) throw std::invalid_argument("calc quad <a> <b> <c>");
+          const double a = std::stod(t[2]);
+          const double b = std::stod(t[3]);
+          const double c = std::stod(t[4]);
+          const auto qr = calc::solve_quadratic(a, b, c);
+          if (jsonFields()) {
+            jsonLine_.field("real", qr.realRoots).beginArray("roots");
+            if (qr.rootCount >= 1) jsonLine_.element(qr.x1);
+            if (qr.rootCount >= 2 && qr.realRoots) jsonLine_.element(qr.x2);
+            jsonLine_.endArray();
+            if (!qr.realRoots && qr.rootCount > 0) jsonLine_.field("imag", qr.imag);
+            break;
+          }
+          std::ostringstream oss;
+          if (qr.rootCount == 0) {
+            oss << "No roots";
+          } else if (qr.realRoots) {
+            if (qr.rootCount == 1) {
+              oss << "x = " << std::setprecision(15) << qr.x1;
             } else {
-              emitOutput("No solution");
+              oss << "x1 = " << std::setprecision(15) << qr.x1 << ", x2 = " << qr.x2;
             }
           } else {
-            throw std::invalid_argument("calc subcommands: eval|evalx|deriv|integ|quad|solve");
+            oss << "x = " << std::setprecision(15) << qr.x1 << " +/- " << qr.imag << "i";
           }
-          break;
+          emitOutput(oss.str());
+        } else if (sub == "solve") {
+          emitLinearSolution(calc::solve_linear_equation(joinTokens(t, 2)));
+        } else {
+          throw std::invalid_argument("calc subcommands: eval|evalx|deriv|integ|quad|solve");
         }
+        break;
+      }
 
-        case CommandId::Equation: {
-          const std::string eq = joinTokens(t, 1);
-          const auto res = calc::solve_linear_equation(eq);
-          if (res.kind == calc::LinearSolveKind::OneSolution) {
-            std::ostringstream oss;
-            oss << "x = " << std::setprecision(15) << res.x;
-            emitOutput(oss.str());
-          } else if (res.kind == calc::LinearSolveKind::InfiniteSolutions) {
-            emitOutput("Infinite solutions");
-          } else {
-            emitOutput("No solution");
-          }
-          break;
-        }
+      case CommandId::Equation: {
+        emitLinearSolution(calc::solve_linear_equation(joinTokens(t, 1)));
+        break;
+      }
+
+      case CommandId::Sonify:
+        sonify(t);
+        break;
 
-        case CommandId::Windows:
-          std::cout << windows_.renderAll();
-          break;
+      case CommandId::Journal:
+        journal(t);
+        break;
 
-        case CommandId::Unknown:
-          emitOutput("Unknown command. Type 'help'.");
-          break;
+      case CommandId::Replay: {
+        requireFileCommands("replay");
+        if (t.size() < 2) throw std::invalid_argument("replay <file>");
+        ReplayStats stats;
+        const bool ok = replay(t[1], stats);
+        emitOutput(std::string(ok ? "replayed " : "replay stopped after ") + std::to_string(stats.records) +
+                   " records in " + std::to_string(stats.seconds * 1000.0) + " ms");
+        if (!ok) throw std::runtime_error("journal unreadable, truncated or for a different machine");
+        break;
       }
-    } catch (const std::exception& e) {
-      emitOutput(std::string("Error: ") + e.what());
+
+      case CommandId::Format: {
+        std::string f = (t.size() >= 2) ? t[1] : "";
+        std::transform(f.begin(), f.end(), f.begin(), ::tolower);
+        if (f == "json") json_ = true;
+        else if (f == "text") json_ = false;
+        else throw std::invalid_argument("format text|json");
+        break;
+      }
+
+      case CommandId::Windows: {
+        if (muted_) break;
+        std::string panes;
+        windows_.renderAll(panes);
+        emitText(panes); // writeOut in text mode, the "out" array in JSON
+        break;
+      }
+
+      case CommandId::Repeat:
+        throw std::invalid_argument("repeat N [verbose] { cmd; cmd ... }");
+
+      case CommandId::Unknown:
+        lastError_ = "unknown command '" + t[0] + "'";
+        if (!json_) emitOutput("Unknown command. Type 'help'.");
+        return LineResult::Error;
     }
+  } catch (const std::exception& e) {
+    lastError_ = e.what();
+    if (!json_) emitOutput("Error: " + lastError_);
+    return LineResult::Error;
   }
+  return LineResult::Ok;
 }
 
 } // namespace wa
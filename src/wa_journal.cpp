@@ -0,0 +1,281 @@
+#include "wolfman_alpha/wa_journal.hpp"
+#include <chrono>
+#include <iterator>
+
+namespace wa {
+
+namespace {
+
+constexpr char kMagic[4] = {'W', 'A', 'J', '2'};
+
+// Bounds-checked cursor over the journal bytes.
+struct Reader {
+  const u8* p;
+  const u8* end;
+
+  bool uvar(std::uint64_t& out) {
+    out = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+      const u8 b = *p++;
+      out |= (std::uint64_t)(b & 0x7F) << shift;
+      if ((b & 0x80) == 0) return true;
+    }
+    return false;
+  }
+
+  bool svar(std::int64_t& out) {
+    std::uint64_t u = 0;
+    if (!uvar(u)) return false;
+    out = (std::int64_t)(u >> 1) ^ -(std::int64_t)(u & 1);
+    return true;
+  }
+
+  bool i32v(int& out) {
+    std::int64_t v = 0;
+    if (!svar(v)) return false;
+    out = (int)v;
+    return true;
+  }
+};
+
+// Header state, validated in full before any of it is applied.
+struct Snapshot {
+  struct RingState {
+    int offset{0};
+    Dir dir{Dir::Right};
+    std::vector<u8> bits; // packed, logical order
+  };
+  int wordBits{64};
+  std::uint64_t ip{0};
+  bool halted{false};
+  std::uint64_t cycles{0};
+  std::vector<RingState> rings;
+};
+
+bool readSnapshot(Reader& rd, const Machine& m, Snapshot& s) {
+  std::uint64_t word = 0, halted = 0;
+  if (!rd.uvar(word) || !rd.uvar(s.ip) || !rd.uvar(halted) || halted > 1 || !rd.uvar(s.cycles)) return false;
+  if (word != 64 && word != 360 && word != 720) return false;
+  s.wordBits = (int)word;
+  s.halted = halted != 0;
+  const int n = m.gearsPerRing();
+  const std::size_t bytes = (std::size_t)(n + 7) / 8;
+  s.rings.resize((std::size_t)m.ringCount());
+  for (auto& r : s.rings) {
+    std::uint64_t dir = 0;
+    if (!rd.i32v(r.offset) || r.offset < 0 || r.offset >= n || !rd.uvar(dir) || dir > 1) return false;
+    if ((std::size_t)(rd.end - rd.p) < bytes) return false;
+    r.dir = (Dir)dir;
+    r.bits.assign(rd.p, rd.p + bytes);
+    rd.p += bytes;
+  }
+  return true;
+}
+
+void applySnapshot(const Snapshot& s, Machine& m, std::unique_ptr<CpuBase>& cpu) {
+  const int n = m.gearsPerRing();
+  for (int r = 0; r < m.ringCount(); ++r) {
+    const auto& st = s.rings[(std::size_t)r];
+    Ring& rg = m.ring(r);
+    // Land on the saved offset moving in the saved direction, as Dial does.
+    const int steps = (st.dir == Dir::Left) ? st.offset - rg.offset() : rg.offset() - st.offset;
+    rg.shift(st.dir, ((steps % n) + n) % n);
+    for (int i = 0; i < n; ++i) rg.setBit(i, (u8)((st.bits[(std::size_t)i >> 3] >> (i & 7)) & 1u));
+  }
+  cpu = make_cpu(s.wordBits, m);
+  cpu->restoreState((std::size_t)s.ip, s.halted, s.cycles);
+}
+
+} // namespace
+
+bool JournalWriter::open(const std::string& path, const Machine& m, const CpuBase& cpu) {
+  close();
+  f_.open(path, std::ios::binary | std::ios::trunc);
+  if (!f_) return false;
+  records_ = 0;
+  buf_.clear();
+  buf_.reserve(kFlushBytes + 32);
+  buf_.insert(buf_.end(), kMagic, kMagic + 4);
+  uvar((std::uint64_t)m.ringCount());
+  uvar((std::uint64_t)m.gearsPerRing());
+  uvar((std::uint64_t)cpu.wordBits());
+  uvar((std::uint64_t)cpu.ip());
+  uvar(cpu.halted() ? 1 : 0);
+  uvar(cpu.cycles());
+  for (int r = 0; r < m.ringCount(); ++r) {
+    const Ring& rg = m.ring(r);
+    svar(rg.offset());
+    uvar((u8)rg.dir());
+    u8 acc = 0;
+    int i = 0;
+    rg.forEachRun(rg.gearCount(), [&](const Gear* g, int len) {
+      for (int k = 0; k < len; ++k, ++i) {
+        acc |= (u8)((g[k].bit & 1u) << (i & 7));
+        if ((i & 7) == 7) {
+          buf_.push_back(acc);
+          acc = 0;
+        }
+      }
+    });
+    if ((i & 7) != 0) buf_.push_back(acc);
+    if (buf_.size() >= kFlushBytes) flushBuffer();
+  }
+  return true;
+}
+
+bool JournalWriter::close() {
+  if (!f_.is_open()) return true;
+  flushBuffer();
+  const bool ok = (bool)f_;
+  f_.close();
+  return ok;
+}
+
+void JournalWriter::flushBuffer() {
+  if (buf_.empty()) return;
+  f_.write(reinterpret_cast<const char*>(buf_.data()), (std::streamsize)buf_.size());
+  buf_.clear();
+}
+
+void JournalWriter::op(JournalOp o) {
+  if (buf_.size() >= kFlushBytes) flushBuffer();
+  buf_.push_back((u8)o);
+  records_++;
+}
+
+void JournalWriter::uvar(std::uint64_t v) {
+  while (v >= 0x80) {
+    buf_.push_back((u8)(v | 0x80));
+    v >>= 7;
+  }
+  buf_.push_back((u8)v);
+}
+
+void JournalWriter::svar(std::int64_t v) {
+  uvar(((std::uint64_t)v << 1) ^ (std::uint64_t)(v >> 63));
+}
+
+void JournalWriter::set(int ring, int index, int value) {
+  if (!isOpen()) return;
+  op(JournalOp::Set);
+  svar(ring);
+  svar(index);
+  svar(value);
+}
+
+void JournalWriter::flip(int ring, int index) {
+  if (!isOpen()) return;
+  op(JournalOp::Flip);
+  svar(ring);
+  svar(index);
+}
+
+void JournalWriter::shift(int ring, Dir d, int steps) {
+  if (!isOpen()) return;
+  op(JournalOp::Shift);
+  svar(ring);
+  uvar((u8)d);
+  svar(steps);
+}
+
+void JournalWriter::tick(int steps) {
+  if (!isOpen()) return;
+  op(JournalOp::Tick);
+  svar(steps);
+}
+
+void JournalWriter::run(int steps) {
+  if (!isOpen()) return;
+  op(JournalOp::Run);
+  svar(steps);
+}
+
+void JournalWriter::mode(int wordBits) {
+  if (!isOpen()) return;
+  op(JournalOp::Mode);
+  svar(wordBits);
+}
+
+void JournalWriter::dial(int ring, bool moved, Dir d, int offset) {
+  if (!isOpen()) return;
+  op(JournalOp::Dial);
+  svar(ring);
+  uvar(moved ? (std::uint64_t)d + 1 : 0);
+  svar(offset);
+}
+
+bool replay_journal(const std::string& path, Machine& m, std::unique_ptr<CpuBase>& cpu, ReplayStats& stats) {
+  stats = ReplayStats{};
+  const auto t0 = std::chrono::steady_clock::now();
+
+  std::ifstream f(path, std::ios::binary);
+  if (!f) return false;
+  const std::vector<u8> data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+  if (data.size() < 4 || !std::equal(kMagic, kMagic + 4, data.begin())) return false;
+
+  Reader rd{data.data() + 4, data.data() + data.size()};
+  std::uint64_t rings = 0, gears = 0;
+  if (!rd.uvar(rings) || !rd.uvar(gears)) return false;
+  if ((int)rings != m.ringCount() || (int)gears != m.gearsPerRing()) return false;
+  Snapshot snap;
+  if (!readSnapshot(rd, m, snap)) return false;
+  applySnapshot(snap, m, cpu);
+
+  bool ok = true;
+  while (rd.p < rd.end) {
+    const auto o = (JournalOp)*rd.p++;
+    int a = 0, b = 0, c = 0;
+    std::uint64_t u = 0;
+    switch (o) {
+      case JournalOp::Set:
+        ok = rd.i32v(a) && rd.i32v(b) && rd.i32v(c);
+        if (ok) m.setBit(a, b, (u8)c);
+        break;
+      case JournalOp::Flip:
+        ok = rd.i32v(a) && rd.i32v(b);
+        if (ok) m.flipBit(a, b);
+        break;
+      case JournalOp::Shift:
+        ok = rd.i32v(a) && rd.uvar(u) && u <= 1 && rd.i32v(c);
+        if (ok) m.shiftRing(a, (Dir)u, c);
+        break;
+      case JournalOp::Tick:
+        ok = rd.i32v(a);
+        if (ok) {
+          m.tickAll(a);
+          if (a > 0) stats.gearTicks += (std::uint64_t)a;
+        }
+        break;
+      case JournalOp::Run:
+        ok = rd.i32v(a);
+        for (int i = 0; ok && i < a && !cpu->halted(); i++) cpu->step();
+        break;
+      case JournalOp::Mode:
+        ok = rd.i32v(a);
+        if (ok) cpu = make_cpu(a, m);
+        break;
+      case JournalOp::Dial:
+        ok = rd.i32v(a) && rd.uvar(u) && u <= 2 && rd.i32v(c);
+        if (ok && u != 0) {
+          // Land on the recorded offset moving in the recorded direction so
+          // both offset and dir match the original session.
+          const Dir d = (Dir)(u - 1);
+          const int n = m.gearsPerRing();
+          const int cur = m.ring(a).offset();
+          const int steps = (d == Dir::Left) ? c - cur : cur - c;
+          m.shiftRing(a, d, ((steps % n) + n) % n);
+        }
+        break;
+      default:
+        ok = false;
+        break;
+    }
+    if (!ok) break;
+    stats.records++;
+  }
+
+  stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  return ok;
+}
+
+} // namespace wa
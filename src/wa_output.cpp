@@ -0,0 +1,63 @@
+#include "wolfman_alpha/wa_output.hpp"
+#include <chrono>
+
+namespace wa {
+
+OutputWriter::OutputWriter(std::ostream& os) : os_(os) {
+  thread_ = std::thread([this] { run(); });
+}
+
+OutputWriter::~OutputWriter() {
+  flush();
+  stop_.store(true, std::memory_order_release);
+  wake_.notify_one();
+  thread_.join();
+}
+
+void OutputWriter::write(std::string&& chunk) {
+  if (chunk.empty()) return;
+  while (!ring_.push(std::move(chunk))) {
+    wake_.notify_one();
+    std::this_thread::yield();
+  }
+  queued_.fetch_add(1, std::memory_order_release);
+  wake_.notify_one();
+}
+
+void OutputWriter::flush() {
+  const std::uint64_t target = queued_.load(std::memory_order_acquire);
+  std::unique_lock<std::mutex> lock(mu_);
+  wake_.notify_one();
+  drained_.wait(lock, [&] { return written_.load(std::memory_order_acquire) >= target; });
+}
+
+void OutputWriter::run() {
+  std::string batch;
+  std::string chunk;
+  while (true) {
+    std::uint64_t n = 0;
+    while (batch.size() < kBatchBytes && ring_.pop(chunk)) {
+      batch += chunk;
+      ++n;
+    }
+    if (n > 0) {
+      // One write and one stream flush per batch, not per chunk.
+      os_.write(batch.data(), (std::streamsize)batch.size());
+      os_.flush();
+      batch.clear();
+      {
+        std::lock_guard<std::mutex> lock(mu_);
+        written_.fetch_add(n, std::memory_order_release);
+      }
+      drained_.notify_all();
+      continue;
+    }
+    if (stop_.load(std::memory_order_acquire)) break;
+    // The timeout covers a notify that raced ahead of this wait.
+    std::unique_lock<std::mutex> lock(mu_);
+    wake_.wait_for(lock, std::chrono::milliseconds(5));
+  }
+  os_.flush();
+}
+
+} // namespace wa
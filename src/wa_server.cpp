@@ -0,0 +1,445 @@
+#include "wolfman_alpha/wa_server.hpp"
+
+#ifdef __linux__
+
+#include "wolfman_alpha/wa_io.hpp"
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace wa {
+
+namespace {
+
+// Output is collected per command, and remote clients get no commands that
+// open files by path.
+ConsoleConfig sessionConsoleConfig() {
+  ConsoleConfig c;
+  c.stdoutWriter = false;
+  c.fileCommands = false;
+  return c;
+}
+
+struct Session {
+  const int fd;
+  Machine machine;
+  Console console;
+
+  std::mutex mu;
+  std::string in;         // received bytes; [inPos, size) not yet executed
+  std::size_t inPos{0};
+  std::string out;        // [outPos, size) waits to be sent
+  std::size_t outPos{0};
+  bool scheduled{false};  // queued on or running on a worker
+  bool quit{false};       // no further input is executed
+  bool eof{false};        // peer finished sending; EPOLLIN is disarmed
+  std::uint32_t events{EPOLLIN | EPOLLRDHUP}; // armed epoll events (I/O thread only)
+
+  Session(int fd_, int rings, int gears)
+    : fd(fd_), machine(rings, gears), console(machine, sessionConsoleConfig()) {}
+
+  std::size_t pendingIn() const { return in.size() - inPos; }
+  std::size_t pendingOut() const { return out.size() - outPos; }
+  bool hasLine() const { return in.find('\n', inPos) != std::string::npos; }
+};
+
+using SessionPtr = std::shared_ptr<Session>;
+
+// True if `addr` names nothing, or a socket file no server answers on (which
+// is then removed). Regular files, directories and live sockets are left
+// alone.
+bool claimSocketPath(const sockaddr_un& addr) {
+  struct stat st{};
+  if (::lstat(addr.sun_path, &st) != 0) return errno == ENOENT;
+  if (!S_ISSOCK(st.st_mode)) return false;
+  const int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (probe < 0) return false;
+  const bool live = ::connect(probe, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0 || errno != ECONNREFUSED;
+  ::close(probe);
+  return !live && ::unlink(addr.sun_path) == 0;
+}
+
+} // namespace
+
+struct ConsoleServer::Impl {
+  ConsoleServer& owner;
+  int listenFd{-1};
+  int epollFd{-1};
+  int wakeFd{-1};
+  std::atomic<bool> stopping{false};
+
+  std::thread io;
+  std::vector<std::thread> workers;
+
+  std::mutex queueMu;
+  std::condition_variable queueCv;
+  std::deque<SessionPtr> queue;
+
+  std::mutex readyMu;
+  std::vector<SessionPtr> ready; // sessions with output for the I/O thread
+
+  std::unordered_map<int, SessionPtr> sessions; // I/O thread only
+
+  explicit Impl(ConsoleServer& o) : owner(o) {}
+
+  void wake() {
+    const std::uint64_t one = 1;
+    (void)!::write(wakeFd, &one, sizeof(one));
+  }
+
+  void schedule(const SessionPtr& s) {
+    {
+      std::lock_guard<std::mutex> lock(queueMu);
+      queue.push_back(s);
+    }
+    queueCv.notify_one();
+  }
+
+  void publish(const SessionPtr& s) {
+    {
+      std::lock_guard<std::mutex> lock(readyMu);
+      ready.push_back(s);
+    }
+    wake();
+  }
+
+  // ---- worker side ----
+
+  void workerLoop() {
+    while (true) {
+      SessionPtr s;
+      {
+        std::unique_lock<std::mutex> lock(queueMu);
+        queueCv.wait(lock, [&] { return stopping.load() || !queue.empty(); });
+        if (queue.empty()) return;
+        s = std::move(queue.front());
+        queue.pop_front();
+      }
+      runSession(*s);
+      publish(s);
+    }
+  }
+
+  // Executes complete lines queued for `s` until the input runs out or the
+  // unsent output passes the high-water mark. The scheduled flag keeps other
+  // workers away, so the console itself is used without the lock.
+  void runSession(Session& s) {
+    std::string line;
+    std::string produced;
+    std::unique_lock<std::mutex> lock(s.mu);
+    while (!s.quit && s.pendingOut() <= owner.cfg_.maxOutputBytes) {
+      const auto nl = s.in.find('\n', s.inPos);
+      if (nl == std::string::npos) break;
+      line.assign(s.in, s.inPos, nl - s.inPos);
+      s.inPos = nl + 1;
+      if (!line.empty() && line.back() == '\r') line.pop_back();
+      lock.unlock();
+
+      const bool more = s.console.executeLine(line);
+      owner.commands_.fetch_add(1, std::memory_order_relaxed);
+      s.console.takeOutput(produced);
+      if (more) produced += s.console.prompt();
+
+      lock.lock();
+      if (!more) s.quit = true;
+      s.out += produced;
+      produced.clear();
+    }
+    // One compaction per run instead of an erase per line.
+    s.in.erase(0, s.inPos);
+    s.inPos = 0;
+    s.scheduled = false;
+  }
+
+  // ---- I/O thread ----
+
+  void ioLoop() {
+    epoll_event events[64];
+    while (!stopping.load(std::memory_order_acquire)) {
+      const int n = ::epoll_wait(epollFd, events, 64, -1);
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        break;
+      }
+      for (int i = 0; i < n; ++i) {
+        const int fd = events[i].data.fd;
+        const std::uint32_t ev = events[i].events;
+        if (fd == listenFd) acceptClients();
+        else if (fd == wakeFd) drainReady();
+        else onClient(fd, ev);
+      }
+    }
+  }
+
+  void acceptClients() {
+    while (true) {
+      const int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0) return; // EAGAIN or a transient error; epoll will report again
+      if (sessions.size() >= owner.cfg_.maxSessions) {
+        static const char kBusy[] = "server full\n";
+        (void)!::send(fd, kBusy, sizeof(kBusy) - 1, MSG_NOSIGNAL);
+        ::close(fd);
+        continue;
+      }
+      auto s = std::make_shared<Session>(fd, owner.cfg_.rings, owner.cfg_.gearsPerRing);
+      epoll_event ev{};
+      ev.events = EPOLLIN | EPOLLRDHUP;
+      ev.data.fd = fd;
+      if (::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        ::close(fd);
+        continue;
+      }
+      sessions.emplace(fd, s);
+      owner.sessionCount_.store(sessions.size(), std::memory_order_relaxed);
+
+      s->console.greet();
+      std::lock_guard<std::mutex> lock(s->mu);
+      s->console.takeOutput(s->out);
+      s->out += s->console.prompt();
+      sendPending(*s);
+      updateEvents(*s);
+    }
+  }
+
+  void onClient(int fd, std::uint32_t ev) {
+    const auto it = sessions.find(fd);
+    if (it == sessions.end()) return;
+    SessionPtr s = it->second;
+
+    if (ev & (EPOLLERR | EPOLLHUP)) {
+      closeSession(fd);
+      return;
+    }
+    if (ev & EPOLLOUT) {
+      std::unique_lock<std::mutex> lock(s->mu);
+      const bool ok = sendPending(*s);
+      const bool done = s->quit && !s->scheduled && s->pendingOut() == 0;
+      if (ok && !done) {
+        maybeSchedule(s);
+        updateEvents(*s);
+      }
+      lock.unlock();
+      if (!ok || done) {
+        closeSession(fd);
+        return;
+      }
+    }
+    if (ev & (EPOLLIN | EPOLLRDHUP)) {
+      char buf[16 * 1024];
+      bool eof = false;
+      std::unique_lock<std::mutex> lock(s->mu);
+      while (true) {
+        const ssize_t r = ::recv(fd, buf, sizeof(buf), 0);
+        if (r > 0) {
+          s->in.append(buf, (std::size_t)r);
+          continue;
+        }
+        if (r < 0 && errno == EINTR) continue;
+        if (r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) eof = true;
+        break;
+      }
+      if (!s->hasLine() && s->pendingIn() > owner.cfg_.maxLineBytes) {
+        lock.unlock();
+        closeSession(fd);
+        return;
+      }
+      // A client that half-closes after sending a script still gets all of
+      // its output: the trailing partial line and an implicit quit are
+      // queued, and the session closes once that output has been sent.
+      if (eof && !s->eof) {
+        s->eof = true;
+        if (!s->in.empty() && s->in.back() != '\n') s->in += '\n';
+        s->in += "quit\n";
+        updateEvents(*s); // stop polling for input that will never come
+      }
+      if (s->quit) {
+        const bool done = !s->scheduled && s->pendingOut() == 0;
+        lock.unlock();
+        if (done) closeSession(fd);
+        return;
+      }
+      maybeSchedule(s);
+      updateEvents(*s);
+    }
+  }
+
+  // Queues `s` on a worker if it has a complete line and room for output.
+  // Caller holds s->mu.
+  void maybeSchedule(const SessionPtr& s) {
+    if (s->scheduled || s->quit || s->pendingOut() > owner.cfg_.maxOutputBytes || !s->hasLine()) return;
+    s->scheduled = true;
+    schedule(s);
+  }
+
+  // Arms EPOLLOUT while output is pending, and EPOLLIN only while the
+  // session can take more input: not after EOF, not while its output is over
+  // the high-water mark, and not while a full line's worth of input is still
+  // waiting to run. The kernel socket buffer then pushes back on the client.
+  // Caller holds s.mu.
+  void updateEvents(Session& s) {
+    std::uint32_t want = 0;
+    if (!s.eof && s.pendingOut() <= owner.cfg_.maxOutputBytes && s.pendingIn() <= owner.cfg_.maxLineBytes) {
+      want |= EPOLLIN | EPOLLRDHUP;
+    }
+    if (s.pendingOut() != 0) want |= EPOLLOUT;
+    if (want == s.events) return;
+    epoll_event ev{};
+    ev.events = want;
+    ev.data.fd = s.fd;
+    ::epoll_ctl(epollFd, EPOLL_CTL_MOD, s.fd, &ev);
+    s.events = want;
+  }
+
+  void drainReady() {
+    std::uint64_t count = 0;
+    (void)!::read(wakeFd, &count, sizeof(count));
+    std::vector<SessionPtr> batch;
+    {
+      std::lock_guard<std::mutex> lock(readyMu);
+      batch.swap(ready);
+    }
+    for (const auto& s : batch) {
+      const auto it = sessions.find(s->fd);
+      if (it == sessions.end() || it->second != s) continue; // already closed
+      bool done = false;
+      {
+        std::lock_guard<std::mutex> lock(s->mu);
+        const bool ok = sendPending(*s);
+        done = !ok || (s->quit && !s->scheduled && s->pendingOut() == 0);
+        if (!done) {
+          maybeSchedule(s);
+          updateEvents(*s);
+        }
+      }
+      if (done) closeSession(s->fd);
+    }
+  }
+
+  // Sends as much of s.out as the socket accepts; the caller re-arms epoll
+  // with updateEvents(). Caller holds s.mu. Returns false on a hard socket
+  // error.
+  bool sendPending(Session& s) {
+    while (s.pendingOut() != 0) {
+      const ssize_t w = ::send(s.fd, s.out.data() + s.outPos, s.pendingOut(), MSG_NOSIGNAL);
+      if (w > 0) {
+        s.outPos += (std::size_t)w;
+        continue;
+      }
+      if (w < 0 && errno == EINTR) continue;
+      if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+      return false;
+    }
+    // Drop the sent prefix once it dominates the buffer (or all of it).
+    if (s.outPos == s.out.size()) {
+      s.out.clear();
+      s.outPos = 0;
+    } else if (s.outPos > s.out.size() / 2) {
+      s.out.erase(0, s.outPos);
+      s.outPos = 0;
+    }
+    return true;
+  }
+
+  void closeSession(int fd) {
+    const auto it = sessions.find(fd);
+    if (it == sessions.end()) return;
+    {
+      std::lock_guard<std::mutex> lock(it->second->mu);
+      it->second->quit = true;
+    }
+    ::epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    sessions.erase(it);
+    owner.sessionCount_.store(sessions.size(), std::memory_order_relaxed);
+  }
+};
+
+ConsoleServer::ConsoleServer(ServerConfig cfg) : cfg_(std::move(cfg)) {}
+
+ConsoleServer::~ConsoleServer() {
+  stop();
+}
+
+bool ConsoleServer::start() {
+  if (running()) return false;
+  sockaddr_un addr{};
+  if (cfg_.socketPath.empty() || cfg_.socketPath.size() >= sizeof(addr.sun_path)) return false;
+
+  impl_ = std::make_unique<Impl>(*this);
+  Impl& im = *impl_;
+  im.listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  im.epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+  im.wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  bool ok = im.listenFd >= 0 && im.epollFd >= 0 && im.wakeFd >= 0;
+
+  if (ok) {
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, cfg_.socketPath.c_str(), cfg_.socketPath.size() + 1);
+    ok = claimSocketPath(addr) &&
+         ::bind(im.listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 &&
+         ::listen(im.listenFd, 128) == 0;
+  }
+  for (int fd : {im.listenFd, im.wakeFd}) {
+    if (!ok) break;
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    ok = ::epoll_ctl(im.epollFd, EPOLL_CTL_ADD, fd, &ev) == 0;
+  }
+  if (!ok) {
+    for (int fd : {im.listenFd, im.epollFd, im.wakeFd}) if (fd >= 0) ::close(fd);
+    impl_.reset();
+    return false;
+  }
+
+  running_.store(true, std::memory_order_release);
+  const unsigned n = cfg_.workers == 0 ? 1 : cfg_.workers;
+  for (unsigned i = 0; i < n; ++i) im.workers.emplace_back([&im] { im.workerLoop(); });
+  im.io = std::thread([&im] { im.ioLoop(); });
+  return true;
+}
+
+void ConsoleServer::stop() {
+  if (!impl_) return;
+  Impl& im = *impl_;
+  im.stopping.store(true, std::memory_order_release);
+  im.wake();
+  if (im.io.joinable()) im.io.join();
+  im.queueCv.notify_all();
+  for (auto& t : im.workers) t.join();
+
+  while (!im.sessions.empty()) im.closeSession(im.sessions.begin()->first);
+  for (int fd : {im.listenFd, im.epollFd, im.wakeFd}) if (fd >= 0) ::close(fd);
+  ::unlink(cfg_.socketPath.c_str());
+  impl_.reset();
+  running_.store(false, std::memory_order_release);
+}
+
+} // namespace wa
+
+#else // !__linux__
+
+namespace wa {
+
+struct ConsoleServer::Impl {};
+
+ConsoleServer::ConsoleServer(ServerConfig cfg) : cfg_(std::move(cfg)) {}
+ConsoleServer::~ConsoleServer() = default;
+bool ConsoleServer::start() { return false; }
+void ConsoleServer::stop() {}
+
+} // namespace wa
+
+#endif
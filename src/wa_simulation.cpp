@@ -0,0 +1,89 @@
+#include "wolfman_alpha/wa_simulation.hpp"
+#include <chrono>
+#include <stdexcept>
+
+namespace wa {
+
+SimulationThread::SimulationThread(MechanicalComputer& mech, SimulationConfig cfg) : mech_(mech), cfg_(std::move(cfg)) {
+  if ((int)cfg_.registers.size() > MachineSnapshot::kMaxWords || (int)cfg_.ramWords.size() > MachineSnapshot::kMaxWords) {
+    throw std::invalid_argument("snapshot holds at most 8 registers and 8 RAM words");
+  }
+  for (int r : cfg_.registers) {
+    if (r < 0 || r >= mech_.registers().count()) throw std::out_of_range("snapshot register");
+  }
+  for (int a : cfg_.ramWords) {
+    if (a < 0 || a >= mech_.ram().words()) throw std::out_of_range("snapshot RAM address");
+  }
+  if (cfg_.stepsPerSlice == 0) cfg_.stepsPerSlice = 1;
+}
+
+SimulationThread::~SimulationThread() {
+  stop();
+}
+
+void SimulationThread::start() {
+  if (thread_.joinable()) return;
+  stop_.store(false, std::memory_order_relaxed);
+  publish(); // readers see the starting state immediately
+  thread_ = std::thread([this] { loop(); });
+}
+
+void SimulationThread::stop() {
+  if (!thread_.joinable()) return;
+  stop_.store(true, std::memory_order_relaxed);
+  thread_.join();
+}
+
+bool SimulationThread::post(std::function<void(MechanicalComputer&)> fn) {
+  return commands_.push(std::move(fn));
+}
+
+void SimulationThread::loop() {
+  std::function<void(MechanicalComputer&)> fn;
+  while (!stop_.load(std::memory_order_relaxed)) {
+    bool changed = false;
+    while (commands_.pop(fn)) {
+      fn(mech_);
+      changed = true;
+    }
+
+    if (freeRun_.load(std::memory_order_relaxed) && !mech_.cpu().halted()) {
+      // step() ticks the clock itself: one tick per step, as in the console.
+      auto& cpu = mech_.cpu();
+      for (std::uint64_t i = 0; i < cfg_.stepsPerSlice && !cpu.halted(); ++i) {
+        cpu.step();
+        steps_++;
+      }
+      publish();
+    } else {
+      if (changed) publish();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  while (commands_.pop(fn)) fn(mech_);
+  publish();
+}
+
+void SimulationThread::publish() {
+  MachineSnapshot& s = snapshots_.writeBuffer();
+  s.seq = ++published_;
+  s.steps = steps_;
+  s.ticks = mech_.clock().ticks();
+  s.clockRunning = mech_.clock().running();
+  s.halted = mech_.cpu().halted();
+  s.freeRun = freeRun_.load(std::memory_order_relaxed);
+  s.ip = mech_.cpu().ip();
+  s.regCount = (int)cfg_.registers.size();
+  for (int i = 0; i < s.regCount; ++i) {
+    s.regIndex[i] = cfg_.registers[i];
+    s.regs[i] = mech_.registers().getU64(cfg_.registers[i]);
+  }
+  s.ramCount = (int)cfg_.ramWords.size();
+  for (int i = 0; i < s.ramCount; ++i) {
+    s.ramAddr[i] = cfg_.ramWords[i];
+    s.ram[i] = mech_.ram().readU64(cfg_.ramWords[i]);
+  }
+  snapshots_.publish();
+}
+
+} // namespace wa
@@ -0,0 +1,139 @@
+#include "wolfman_alpha/wa_sonify.hpp"
+#include "wolfman_alpha/wa_osc.hpp"
+#include "wolfman_alpha/wa_synth.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace wa::audio {
+
+namespace {
+
+// A decaying grain of `seconds`: `tone` scaled by an envelope that runs
+// once over the grain. Rendered once through the block pipeline.
+std::vector<double> render_grain(SynthGraph& g, SynthNode tone, double seconds, double decayRate) {
+  const int sr = g.sampleRate();
+  const int n = std::max(1, (int)std::round(seconds * sr));
+  g.setOutput(g.mul(g.envelope((double)sr / n, 1.0, decayRate), tone));
+  std::vector<double> out((std::size_t)n);
+  SynthGraph::Scratch scratch;
+  for (int i = 0; i < n; i += kOscBlock) g.process(i, std::min(kOscBlock, n - i), out.data() + i, scratch);
+  return out;
+}
+
+} // namespace
+
+EventSonifier::EventSonifier(SoundEventQueue& queue, SonifyConfig cfg) : queue_(queue), cfg_(cfg) {
+  const int sr = cfg_.sampleRate;
+  {
+    SynthGraph g(sr);
+    const auto tone = g.mix({{g.mix({{g.sine(1800.0), 0.6}, {g.sine(2600.0), 0.4}}), 0.35}, {g.noise(), 0.15}});
+    tick_ = render_grain(g, tone, 0.03, 7.0);
+  }
+  {
+    SynthGraph g(sr);
+    const auto tone = g.mix({{g.mix({{g.sine(140.0), 0.65}, {g.sine(280.0), 0.35}}), 0.18}, {g.noise(), 0.03}});
+    whirr_ = render_grain(g, tone, 0.12, 3.0);
+  }
+  {
+    SynthGraph g(sr);
+    const auto tone = g.mix({{g.mix({{g.sine(220.0), 0.7}, {g.sine(440.0), 0.3}}), 0.22}});
+    pulse_ = render_grain(g, tone, 0.25, 6.0);
+  }
+  {
+    SynthGraph g(sr);
+    std::vector<SynthNode> partials;
+    std::vector<double> gains;
+    for (int k = 0; k < 4; ++k) {
+      partials.push_back(g.sine(48.0 * (k + 1)));
+      gains.push_back(1.0 / (1.0 + 0.35 * k));
+    }
+    halt_ = render_grain(g, g.mix({{g.mix(partials, gains), 0.12}}), 0.40, 4.0);
+  }
+  active_.reserve(64);
+}
+
+EventSonifier::~EventSonifier() {
+  stop();
+}
+
+bool EventSonifier::start(const std::string& wavPath) {
+  if (running()) return false;
+  if (!out_.open(wavPath, WavFormat{cfg_.sampleRate, 1, cfg_.format})) return false;
+  written_ = 0;
+  haveOrigin_ = false;
+  active_.clear();
+  rendered_.store(0, std::memory_order_relaxed);
+  stop_.store(false, std::memory_order_relaxed);
+  thread_ = std::thread([this] { run(); });
+  return true;
+}
+
+void EventSonifier::stop() {
+  if (!running()) return;
+  stop_.store(true, std::memory_order_release);
+  thread_.join();
+}
+
+void EventSonifier::run() {
+  SoundEvent ev;
+  while (!stop_.load(std::memory_order_acquire)) {
+    bool any = false;
+    while (queue_.pop(ev)) {
+      handle(ev);
+      any = true;
+    }
+    if (!any) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  while (queue_.pop(ev)) handle(ev);
+  u64 end = written_;
+  for (const auto& v : active_) end = std::max<u64>(end, v.start + v.grain->size());
+  renderUntil(end);
+  out_.close();
+}
+
+void EventSonifier::handle(const SoundEvent& ev) {
+  if (!haveOrigin_) {
+    originTick_ = ev.tick;
+    haveOrigin_ = true;
+  }
+  // Unsigned difference: clamp, or an early tick would wrap to ~1.8e19.
+  const double ticks = ev.tick > originTick_ ? (double)(ev.tick - originTick_) : 0.0;
+  const u64 at = std::max<u64>(written_, (u64)std::llround(ticks * cfg_.sampleRate / cfg_.clockHz));
+  renderUntil(at);
+
+  const std::vector<double>* grain = &tick_;
+  switch (ev.kind) {
+    case SoundEventKind::Instr:     grain = &tick_; break;
+    case SoundEventKind::RingShift: grain = &whirr_; break;
+    case SoundEventKind::Zodiac:    grain = &pulse_; break;
+    case SoundEventKind::Halt:      grain = &halt_; break;
+  }
+  active_.push_back({grain, at});
+  rendered_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void EventSonifier::renderUntil(u64 end) {
+  double block[kOscBlock];
+  while (written_ < end) {
+    const std::size_t n = (std::size_t)std::min<u64>(kOscBlock, end - written_);
+    std::fill(block, block + n, 0.0);
+
+    for (const auto& v : active_) {
+      const std::size_t off = (std::size_t)(written_ - v.start);
+      const std::size_t len = std::min(n, v.grain->size() - off);
+      const double* g = v.grain->data() + off;
+      for (std::size_t i = 0; i < len; ++i) block[i] += cfg_.gain * g[i];
+    }
+
+    written_ += n;
+    active_.erase(std::remove_if(active_.begin(), active_.end(), [this](const Voice& v) {
+      return v.start + v.grain->size() <= written_;
+    }), active_.end());
+
+    out_.writeFrames(block, n);
+  }
+}
+
+} // namespace wa::audio
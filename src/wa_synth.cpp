@@ -0,0 +1,221 @@
+#include "wolfman_alpha/wa_synth.hpp"
+#include "wolfman_alpha/wa_osc.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace wa::audio {
+
+void SynthGraph::checkInput(SynthNode n) const {
+  if (n < 0 || n >= static_cast<SynthNode>(nodes_.size())) throw std::out_of_range("synth node input");
+}
+
+SynthNode SynthGraph::add(const Node& n) {
+  nodes_.push_back(n);
+  if (outputRight_ < 0) output_ = static_cast<SynthNode>(nodes_.size()) - 1;
+  return static_cast<SynthNode>(nodes_.size()) - 1;
+}
+
+void SynthGraph::setOutput(SynthNode left, SynthNode right) {
+  checkInput(left);
+  checkInput(right);
+  output_ = left;
+  outputRight_ = right;
+}
+
+SynthNode SynthGraph::constant(double v) {
+  Node n;
+  n.op = Op::Const;
+  n.p0 = v;
+  return add(n);
+}
+
+SynthNode SynthGraph::sine(double hz) {
+  Node n;
+  n.op = Op::SineHz;
+  n.p0 = hz;
+  return add(n);
+}
+
+SynthNode SynthGraph::sine(SynthNode freq, double freqScale) {
+  checkInput(freq);
+  Node n;
+  n.op = Op::SineIn;
+  n.a = freq;
+  n.p0 = freqScale;
+  return add(n);
+}
+
+SynthNode SynthGraph::noise() {
+  Node n;
+  n.op = Op::Noise;
+  return add(n);
+}
+
+SynthNode SynthGraph::envelope(double hz, double window, double rate) {
+  if (window * rate > 8.0) throw std::invalid_argument("envelope window*rate exceeds exp_neg range");
+  Node n;
+  n.op = Op::Envelope;
+  n.p0 = hz;
+  n.p1 = window;
+  n.p2 = rate;
+  return add(n);
+}
+
+SynthNode SynthGraph::stepSeq(double hz, std::vector<double> values) {
+  if (values.empty()) throw std::invalid_argument("stepSeq needs at least one value");
+  Node n;
+  n.op = Op::StepSeq;
+  n.p0 = hz;
+  n.first = static_cast<int>(table_.size());
+  n.count = static_cast<int>(values.size());
+  table_.insert(table_.end(), values.begin(), values.end());
+  return add(n);
+}
+
+SynthNode SynthGraph::affine(SynthNode in, double gain, double bias) {
+  checkInput(in);
+  Node n;
+  n.op = Op::Affine;
+  n.a = in;
+  n.p0 = gain;
+  n.p1 = bias;
+  return add(n);
+}
+
+SynthNode SynthGraph::mul(SynthNode a, SynthNode b, double gain) {
+  checkInput(a);
+  checkInput(b);
+  Node n;
+  n.op = Op::Mul;
+  n.a = a;
+  n.b = b;
+  n.p0 = gain;
+  return add(n);
+}
+
+SynthNode SynthGraph::mix(std::initializer_list<std::pair<SynthNode, double>> terms) {
+  std::vector<SynthNode> in;
+  std::vector<double> gains;
+  for (const auto& t : terms) {
+    in.push_back(t.first);
+    gains.push_back(t.second);
+  }
+  return mix(in, gains);
+}
+
+SynthNode SynthGraph::mix(const std::vector<SynthNode>& in, const std::vector<double>& gains) {
+  if (in.empty() || in.size() != gains.size()) throw std::invalid_argument("mix needs matching inputs and gains");
+  for (SynthNode s : in) checkInput(s);
+  Node n;
+  n.op = Op::Mix;
+  n.first = static_cast<int>(inputs_.size());
+  n.count = static_cast<int>(in.size());
+  inputs_.insert(inputs_.end(), in.begin(), in.end());
+  gains_.insert(gains_.end(), gains.begin(), gains.end());
+  return add(n);
+}
+
+SynthNode SynthGraph::limit(SynthNode in, double ceiling) {
+  checkInput(in);
+  Node n;
+  n.op = Op::Limit;
+  n.a = in;
+  n.p0 = ceiling;
+  return add(n);
+}
+
+void SynthGraph::process(std::int64_t n0, int count, double* out, Scratch& scratch) const {
+  if (output_ < 0) throw std::logic_error("synth graph has no output");
+  if (count <= 0) return;
+  if (count > kOscBlock) throw std::invalid_argument("synth block exceeds kOscBlock");
+
+  // Slot 0 holds sample time; node k writes slot k+1.
+  scratch.buffers.resize((nodes_.size() + 1) * kOscBlock);
+  double* t = scratch.buffers.data();
+  for (int i = 0; i < count; i++) t[i] = static_cast<double>(n0 + i) / sampleRate_;
+
+  auto buf = [&](SynthNode k) { return scratch.buffers.data() + (static_cast<std::size_t>(k) + 1) * kOscBlock; };
+
+  const SynthNode last = std::max(output_, outputRight_);
+  for (SynthNode k = 0; k <= last; ++k) {
+    const Node& n = nodes_[k];
+    double* o = buf(k);
+    switch (n.op) {
+      case Op::Const:
+        std::fill(o, o + count, n.p0);
+        break;
+
+      case Op::SineHz:
+        for (int i = 0; i < count; i++) o[i] = sin_cycles(n.p0 * t[i]);
+        break;
+
+      case Op::SineIn: {
+        const double* f = buf(n.a);
+        for (int i = 0; i < count; i++) o[i] = sin_cycles((n.p0 * f[i]) * t[i]);
+        break;
+      }
+
+      case Op::Noise:
+        for (int i = 0; i < count; i++) o[i] = dnoise_cycles(t[i]);
+        break;
+
+      case Op::Envelope:
+        for (int i = 0; i < count; i++) o[i] = decay_window(frac_cycles(t[i] * n.p0), n.p1, n.p2);
+        break;
+
+      case Op::StepSeq: {
+        const double* tab = table_.data() + n.first;
+        for (int i = 0; i < count; i++) o[i] = tab[static_cast<std::int64_t>(t[i] * n.p0) % n.count];
+        break;
+      }
+
+      case Op::Affine: {
+        const double* x = buf(n.a);
+        for (int i = 0; i < count; i++) o[i] = n.p0 * x[i] + n.p1;
+        break;
+      }
+
+      case Op::Mul: {
+        const double* x = buf(n.a);
+        const double* y = buf(n.b);
+        for (int i = 0; i < count; i++) o[i] = n.p0 * x[i] * y[i];
+        break;
+      }
+
+      case Op::Mix: {
+        const double* x = buf(inputs_[n.first]);
+        const double g = gains_[n.first];
+        for (int i = 0; i < count; i++) o[i] = g * x[i];
+        for (int j = 1; j < n.count; ++j) {
+          const double* xj = buf(inputs_[n.first + j]);
+          const double gj = gains_[n.first + j];
+          for (int i = 0; i < count; i++) o[i] += gj * xj[i];
+        }
+        break;
+      }
+
+      case Op::Limit: {
+        const double* x = buf(n.a);
+        const double c = n.p0;
+        for (int i = 0; i < count; i++) {
+          const double lo = (x[i] < -c) ? -c : x[i];
+          o[i] = (lo > c) ? c : lo;
+        }
+        break;
+      }
+    }
+  }
+
+  const double* l = buf(output_);
+  if (outputRight_ < 0) {
+    std::copy(l, l + count, out);
+  } else {
+    const double* r = buf(outputRight_);
+    for (int i = 0; i < count; i++) {
+      out[2 * i] = l[i];
+      out[2 * i + 1] = r[i];
+    }
+  }
+}
+
+} // namespace wa::audio
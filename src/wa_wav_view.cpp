@@ -0,0 +1,165 @@
+#include "wolfman_alpha/wa_wav_view.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define WA_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace wa::audio {
+
+namespace {
+
+std::uint16_t rd16(const unsigned char* p) { return (std::uint16_t)(p[0] | (p[1] << 8)); }
+std::uint32_t rd32(const unsigned char* p) {
+  return (std::uint32_t)p[0] | ((std::uint32_t)p[1] << 8) | ((std::uint32_t)p[2] << 16) | ((std::uint32_t)p[3] << 24);
+}
+
+// Walks the RIFF chunk list; fills fmt/data on success.
+bool parse_wav(const unsigned char* p, std::size_t len, WavFormat& fmt, const unsigned char*& data, std::size_t& dataBytes) {
+  if (len < 12 || std::memcmp(p, "RIFF", 4) != 0 || std::memcmp(p + 8, "WAVE", 4) != 0) return false;
+  bool haveFmt = false;
+  int tag = 0, bits = 0;
+  std::size_t pos = 12;
+  while (pos + 8 <= len) {
+    const unsigned char* id = p + pos;
+    const std::size_t size = rd32(p + pos + 4);
+    const std::size_t body = pos + 8;
+    if (std::memcmp(id, "fmt ", 4) == 0 && size >= 16 && body + 16 <= len) {
+      tag = rd16(p + body);
+      fmt.channels = rd16(p + body + 2);
+      fmt.sampleRate = (int)rd32(p + body + 4);
+      bits = rd16(p + body + 14);
+      // WAVE_FORMAT_EXTENSIBLE keeps the real tag at the start of the subformat GUID.
+      if (tag == 0xFFFE && size >= 40 && body + 26 <= len) tag = rd16(p + body + 24);
+      haveFmt = true;
+    } else if (std::memcmp(id, "data", 4) == 0 && haveFmt) {
+      data = p + body;
+      dataBytes = std::min(size, len - body);
+      if (tag == 1 && bits == 16) fmt.format = SampleFormat::Pcm16;
+      else if (tag == 1 && bits == 24) fmt.format = SampleFormat::Pcm24;
+      else if (tag == 3 && bits == 32) fmt.format = SampleFormat::Float32;
+      else return false;
+      return fmt.channels > 0 && fmt.sampleRate > 0;
+    }
+    pos = body + size + (size & 1);
+  }
+  return false;
+}
+
+} // namespace
+
+WavView::WavView(WavView&& other) noexcept { *this = std::move(other); }
+
+WavView& WavView::operator=(WavView&& other) noexcept {
+  if (this == &other) return *this;
+  close();
+  fmt_ = other.fmt_;
+  frames_ = other.frames_;
+  data_ = other.data_;
+  dataBytes_ = other.dataBytes_;
+  map_ = other.map_;
+  mapLen_ = other.mapLen_;
+  owned_ = std::move(other.owned_);
+  other.data_ = nullptr;
+  other.map_ = nullptr;
+  other.mapLen_ = 0;
+  other.frames_ = 0;
+  other.dataBytes_ = 0;
+  return *this;
+}
+
+bool WavView::open(const std::string& path) {
+  close();
+  const unsigned char* base = nullptr;
+  std::size_t len = 0;
+
+#ifdef WA_HAVE_MMAP
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    struct stat st{};
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+      void* m = ::mmap(nullptr, (std::size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (m != MAP_FAILED) {
+        map_ = m;
+        mapLen_ = (std::size_t)st.st_size;
+        base = static_cast<const unsigned char*>(m);
+        len = mapLen_;
+      }
+    }
+    ::close(fd);
+  }
+#endif
+
+  if (!base) {
+    std::ifstream f(path, std::ios::binary);
+    if (!f) return false;
+    owned_.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+    base = owned_.data();
+    len = owned_.size();
+  }
+
+  const unsigned char* data = nullptr;
+  std::size_t dataBytes = 0;
+  if (!base || !parse_wav(base, len, fmt_, data, dataBytes)) {
+    close();
+    return false;
+  }
+  data_ = data;
+  frames_ = dataBytes / ((std::size_t)fmt_.channels * fmt_.bytesPerSample());
+  dataBytes_ = (std::size_t)frames_ * fmt_.channels * fmt_.bytesPerSample();
+  return true;
+}
+
+void WavView::close() {
+#ifdef WA_HAVE_MMAP
+  if (map_) ::munmap(map_, mapLen_);
+#endif
+  map_ = nullptr;
+  mapLen_ = 0;
+  owned_.clear();
+  owned_.shrink_to_fit();
+  data_ = nullptr;
+  dataBytes_ = 0;
+  frames_ = 0;
+  fmt_ = WavFormat{};
+}
+
+void WavView::decode(std::uint64_t frame0, std::size_t count, int channel, double* out) const {
+  const int ch = fmt_.channels;
+  if (channel < -1 || channel >= ch) throw std::out_of_range("channel out of range");
+  const std::size_t avail = frame0 < frames_ ? (std::size_t)std::min<std::uint64_t>(count, frames_ - frame0) : 0;
+  const int bps = fmt_.bytesPerSample();
+  const int c0 = channel < 0 ? 0 : channel;
+  const int c1 = channel < 0 ? ch : channel + 1;
+  const double norm = 1.0 / (double)(c1 - c0);
+  const unsigned char* p = data_ + (std::size_t)frame0 * ch * bps;
+
+  for (std::size_t i = 0; i < avail; ++i, p += (std::size_t)ch * bps) {
+    double acc = 0.0;
+    for (int c = c0; c < c1; ++c) {
+      const unsigned char* s = p + (std::size_t)c * bps;
+      if (fmt_.format == SampleFormat::Pcm16) {
+        acc += (double)(std::int16_t)rd16(s) * (1.0 / 32767.0);
+      } else if (fmt_.format == SampleFormat::Pcm24) {
+        const std::int32_t v = (std::int32_t)((std::uint32_t)s[0] << 8 | (std::uint32_t)s[1] << 16 | (std::uint32_t)s[2] << 24) >> 8;
+        acc += (double)v * (1.0 / 8388607.0);
+      } else {
+        float f;
+        std::memcpy(&f, s, sizeof(f));
+        acc += (double)f;
+      }
+    }
+    out[i] = acc * norm;
+  }
+  std::fill(out + avail, out + count, 0.0);
+}
+
+} // namespace wa::audio
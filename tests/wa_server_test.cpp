@@ -0,0 +1,93 @@
+// Server regression test: malformed commands from one client must come back
+// as errors, not take down the shared server process.
+#include "wolfman_alpha/wa_server.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+  if (!ok) {
+    std::fprintf(stderr, "FAIL: %s\n", what.c_str());
+    ++failures;
+  }
+}
+
+int connectTo(const std::string& path) {
+  const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  std::snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path.c_str());
+  if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) return -1;
+  return fd;
+}
+
+// Sends `line` and reads until `until` shows up or a second passes.
+std::string roundTrip(int fd, const std::string& line, const std::string& until) {
+  (void)!::send(fd, line.data(), line.size(), MSG_NOSIGNAL);
+  std::string got;
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+  while (got.find(until) == std::string::npos && std::chrono::steady_clock::now() < deadline) {
+    pollfd p{fd, POLLIN, 0};
+    if (::poll(&p, 1, 50) <= 0) continue;
+    char buf[4096];
+    const ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0) break;
+    got.append(buf, (std::size_t)n);
+  }
+  return got;
+}
+
+} // namespace
+
+int main() {
+  const std::string path = "/tmp/wa_server_test." + std::to_string(::getpid()) + ".sock";
+  wa::ServerConfig cfg;
+  cfg.socketPath = path;
+  cfg.workers = 2;
+  wa::ConsoleServer server(cfg);
+  if (!server.start()) {
+    std::fprintf(stderr, "cannot start server on %s\n", path.c_str());
+    return 1;
+  }
+
+  const int bystander = connectTo(path);
+  const int client = connectTo(path);
+  check(bystander >= 0 && client >= 0, "clients connect");
+  roundTrip(client, "format json\n", "\"format\":\"json\"");
+
+  for (const char* cmd : {"set", "set 0", "set 0 1", "mode", "run", "flip", "flip 0", "shift", "shift 0",
+                          "print", "glyph", "calc", "dial", "journal on", "sonify on", "replay"}) {
+    const std::string reply = roundTrip(client, std::string(cmd) + "\n", "\n");
+    check(reply.find("\"ok\":false") != std::string::npos, std::string("'") + cmd + "' is rejected, got: " + reply);
+  }
+
+  check(server.running(), "server survives malformed commands");
+  const std::string other = roundTrip(bystander, "tick 2\nclock status\n", "total_ticks=2");
+  check(other.find("total_ticks=2") != std::string::npos, "other sessions keep working");
+
+  ::close(client);
+  ::close(bystander);
+  server.stop();
+  if (failures == 0) std::printf("wa_server_test: ok\n");
+  return failures == 0 ? 0 : 1;
+}
+
+#else
+
+int main() {
+  std::printf("wa_server_test: skipped (needs Linux)\n");
+  return 0;
+}
+
+#endif